@@ -3,6 +3,19 @@
 
 #include "common.h"
 
+// Reallocates the array, `old` is its current size in bytes (0 if `p` is NULL).
+// By default big arrays are grown with mremap by bigalloc.h. If ds_realloc is
+// defined before ar.h it's used instead, and AR_NO_BIGALLOC falls back to
+// realloc.
+#ifndef ar_realloc
+#  if defined(ds_realloc) || defined(AR_NO_BIGALLOC)
+#    define ar_realloc(p, old, size) ds_realloc(p, size)
+#  else
+#    include "bigalloc.h"
+#    define ar_realloc(p, old, size) ds_big_realloc(p, old, size)
+#  endif
+#endif
+
 #ifndef ds_realloc
 #  define ds_realloc realloc
 #endif
@@ -15,7 +28,7 @@ struct ar_head {
 
 #define arinit(p)                                                              \
   do {                                                                         \
-    struct ar_head* _h = ds_realloc(NULL, sizeof(*_h) + sizeof(*p) * 2);       \
+    struct ar_head* _h = ar_realloc(NULL, 0, sizeof(*_h) + sizeof(*p));        \
     _h->len = 0;                                                               \
     _h->cap = 1;                                                               \
     p = (typeof(p))&_h->elms;                                                  \
@@ -24,7 +37,8 @@ struct ar_head {
 #define arfree(p)                                                              \
   do {                                                                         \
     /* warning is emitted when we dont use realloc's return value */           \
-    ds_unused void* _ = ds_realloc(ds_skip_back(struct ar_head, elms, p), 0);  \
+    struct ar_head* _h = ds_skip_back(struct ar_head, elms, p);                \
+    ds_unused void* _ = ar_realloc(_h, sizeof(*_h) + sizeof(*p) * _h->cap, 0); \
   } while (0)
 
 #define arlen(p)                                                               \
@@ -45,8 +59,9 @@ struct ar_head {
     size_t _l = _h->len;                                                       \
     _h->len += n;                                                              \
     if (_h->len >= _h->cap) {                                                  \
+      ds_unused size_t _o = sizeof(*_h) + sizeof(*p) * _h->cap;                \
       _h->cap = ds_max(_h->cap * 2, _h->len);                                  \
-      _h = ds_realloc(_h, sizeof(*_h) + sizeof(*p) * _h->cap);                 \
+      _h = ar_realloc(_h, _o, sizeof(*_h) + sizeof(*p) * _h->cap);             \
       p = (typeof(p))&_h->elms;                                                \
     }                                                                          \
     typeof(*(p))* _c = p + _l;                                                 \
@@ -63,8 +78,9 @@ struct ar_head {
     struct ar_head* _h = ds_skip_back(struct ar_head, elms, p);                \
     size_t _c = _h->len + n;                                                   \
     if (_c >= _h->cap) {                                                       \
+      ds_unused size_t _o = sizeof(*_h) + sizeof(*p) * _h->cap;                \
       _h->cap = _c;                                                            \
-      _h = ds_realloc(_h, sizeof(*_h) + sizeof(*p) * _h->cap);                 \
+      _h = ar_realloc(_h, _o, sizeof(*_h) + sizeof(*p) * _h->cap);             \
       p = (typeof(p))&_h->elms;                                                \
     }                                                                          \
   })
@@ -0,0 +1,169 @@
+#ifndef DS_ARENA_H
+#define DS_ARENA_H
+
+#include "common.h"
+#include "x.h"
+
+#include <string.h>
+
+/*
+ * # Arena allocator
+ *
+ * Memory is carved out of big chunks and all of it is returned at once by
+ * `ds_arena_deinit`, so per-request data needs no individual frees.
+ *
+ * ## Bump allocation
+ *
+ * `ds_arena_alloc` just moves a pointer. The memory can't be freed separately.
+ *
+ * ## Pooled allocation
+ *
+ * `ds_arena_palloc`, `ds_arena_pfree` and `ds_arena_realloc` round sizes up to
+ * a power of two and keep freed blocks in a free list per size class, so
+ * growing arrays and rehashing tables reuse each others' blocks instead of
+ * going to malloc. To use them from the generators:
+ *
+ * ```
+ * #define ds_realloc(p, s) ds_arena_realloc(&arena, p, s) // before ar.h
+ *
+ * #define HT_TABLE_EXTRA_VARS struct ds_arena* arena;
+ * #define HT_ALLOC(t, size) ds_arena_palloc((t)->arena, size)
+ * #define HT_FREE(t, ptr, size) ds_arena_pfree((t)->arena, ptr)
+ * ```
+ *
+ * and set `t.arena` before `init`, or use `alloc_with`.
+ *
+ * Running out of memory traps like x.h.
+ */
+
+#ifndef DS_ARENA_CHUNK
+// Size of the chunks requested from malloc
+#  define DS_ARENA_CHUNK (64 * 1024)
+#endif
+
+#define DS_ARENA_ALIGN 16
+#define DS_ARENA_CLASSES 48 // blocks of up to 2^(DS_ARENA_CLASSES-1) bytes
+
+struct ds_arena_chunk {
+  struct ds_arena_chunk* prev;
+  size_t size;
+  byte data[] __attribute__((aligned(DS_ARENA_ALIGN)));
+};
+
+struct ds_arena {
+  struct ds_arena_chunk* chunk; // current chunk, older ones linked by prev
+  byte* pos;                    // free space of the current chunk
+  byte* end;
+  void* free[DS_ARENA_CLASSES]; // free lists of pooled blocks by size class
+  size_t reserved;              // bytes requested from malloc
+  size_t used;                  // bytes handed out and not pfree'd
+};
+
+// header in front of pooled blocks, keeps the alignment of the block
+struct ds_arena_block {
+  union {
+    size_t cls;
+    void* next; // free list link while the block is free
+    byte _align[DS_ARENA_ALIGN];
+  };
+  byte data[];
+};
+
+static void ds_arena_init(struct ds_arena* a) { memset(a, 0, sizeof(*a)); }
+
+/**
+ * Frees everything allocated from the arena.
+ */
+static void ds_arena_deinit(struct ds_arena* a) {
+  struct ds_arena_chunk* c = a->chunk;
+  while (c) {
+    struct ds_arena_chunk* p = c->prev;
+    xfree(c);
+    c = p;
+  }
+  ds_arena_init(a);
+}
+
+/**
+ * Bump allocates `size` bytes aligned to DS_ARENA_ALIGN.
+ */
+static void* ds_arena_alloc(struct ds_arena* a, size_t size) {
+  size = (size + DS_ARENA_ALIGN - 1) & ~(size_t)(DS_ARENA_ALIGN - 1);
+  if (ds_unlikely((size_t)(a->end - a->pos) < size)) {
+    size_t cs = ds_max(size, (size_t)DS_ARENA_CHUNK);
+    struct ds_arena_chunk* c = xmalloc(sizeof(*c) + cs);
+    c->size = cs;
+    a->reserved += sizeof(*c) + cs;
+    if (cs > DS_ARENA_CHUNK && a->chunk) {
+      // big allocation gets its own chunk, keep bumping in the current one
+      c->prev = a->chunk->prev;
+      a->chunk->prev = c;
+      a->used += size;
+      return c->data;
+    }
+    c->prev = a->chunk;
+    a->chunk = c;
+    a->pos = c->data;
+    a->end = c->data + cs;
+  }
+  void* p = a->pos;
+  a->pos += size;
+  a->used += size;
+  return p;
+}
+
+static size_t ds_arena_class(size_t size) {
+  size += sizeof(struct ds_arena_block);
+  return size <= 32 ? 5 : 64 - __builtin_clzll(size - 1);
+}
+
+/**
+ * Allocates a block that can be returned with ds_arena_pfree.
+ */
+static void* ds_arena_palloc(struct ds_arena* a, size_t size) {
+  size_t cls = ds_arena_class(size);
+  struct ds_arena_block* b = a->free[cls];
+  if (b) {
+    a->free[cls] = b->next;
+    a->used += (size_t)1 << cls;
+  } else {
+    b = ds_arena_alloc(a, (size_t)1 << cls);
+  }
+  b->cls = cls;
+  return b->data;
+}
+
+/**
+ * Puts a block from ds_arena_palloc on the free list for reuse.
+ */
+static void ds_arena_pfree(struct ds_arena* a, void* p) {
+  if (!p)
+    return;
+  struct ds_arena_block* b = ds_skip_back(struct ds_arena_block, data, p);
+  size_t cls = b->cls;
+  a->used -= (size_t)1 << cls;
+  b->next = a->free[cls];
+  a->free[cls] = b;
+}
+
+/**
+ * realloc for pooled blocks. `p` can be NULL, size 0 frees the block.
+ */
+static void* ds_arena_realloc(struct ds_arena* a, void* p, size_t size) {
+  if (!size) {
+    ds_arena_pfree(a, p);
+    return NULL;
+  }
+  if (!p)
+    return ds_arena_palloc(a, size);
+  struct ds_arena_block* b = ds_skip_back(struct ds_arena_block, data, p);
+  size_t have = ((size_t)1 << b->cls) - sizeof(*b);
+  if (size <= have)
+    return p;
+  void* n = ds_arena_palloc(a, size);
+  memcpy(n, p, have);
+  ds_arena_pfree(a, p);
+  return n;
+}
+
+#endif
@@ -0,0 +1,54 @@
+// Throughput of ar.h arpush, arpushm and arforev for 8 and 32 byte elements.
+// usage: ar_suite [--csv|--json] [--max N] [--ops N] [--quick]
+
+#include "bench.h"
+
+#include "../ar.h"
+
+struct wide {
+  u64 a, b, c, d;
+};
+
+// pushes one at a time, pushes in chunks of 64 and sums with arforev
+#define AR_RUN(T, name, n)                                                     \
+  do {                                                                         \
+    size_t reps = ds_max(bench_ops / n, (size_t)1);                            \
+    double tpush = 0, tpushm = 0, tfor = 0;                                    \
+    u64 sum = 0;                                                               \
+    for (size_t r = 0; r < reps; r++) {                                        \
+      T* a;                                                                    \
+      arinit(a);                                                               \
+      double t0 = now();                                                       \
+      for (size_t i = 0; i < n; i++)                                           \
+        arpush(a, (T){i});                                                     \
+      double t1 = now();                                                       \
+      arfree(a);                                                               \
+      arinit(a);                                                               \
+      double t2 = now();                                                       \
+      for (size_t i = 0; i < n; i += 64) {                                     \
+        T* c = arpushm(a, 64);                                                 \
+        for (size_t j = 0; j < 64; j++)                                        \
+          c[j] = (T){i + j};                                                   \
+      }                                                                        \
+      double t3 = now();                                                       \
+      arforev(a, v) sum += *(u64*)&v;                                          \
+      double t4 = now();                                                       \
+      escape(&sum);                                                            \
+      arfree(a);                                                               \
+      tpush += t1 - t0;                                                        \
+      tpushm += t3 - t2;                                                       \
+      tfor += t4 - t3;                                                         \
+    }                                                                          \
+    double ops = (double)n * reps;                                             \
+    bench_row("ar", name, n, "arpush", ops, tpush);                            \
+    bench_row("ar", name, n, "arpushm64", ops, tpushm);                        \
+    bench_row("ar", name, n, "arforev", ops, tfor);                            \
+  } while (0)
+
+int main(int argc, char** argv) {
+  bench_args(argc, argv);
+  bench_forsizes(n) {
+    AR_RUN(u64, "u64", n);
+    AR_RUN(struct wide, "wide32", n);
+  }
+}
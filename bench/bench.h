@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static void escape(void* p) { asm volatile("" : : "g"(p) : "memory"); }
+
+// monotonic time in seconds
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// xorshift64, fast enough not to show up in the measurements
+static unsigned long long bench_rand(unsigned long long* s) {
+  *s ^= *s << 13;
+  *s ^= *s >> 7;
+  *s ^= *s << 17;
+  return *s;
+}
+
+// Output format of bench_row, set by bench_args
+enum { BENCH_TEXT, BENCH_CSV, BENCH_JSON };
+static int bench_fmt = BENCH_TEXT;
+static size_t bench_max = 1 << 23; // biggest table/array size
+static size_t bench_ops = 1 << 22; // operations per measurement at least
+
+// Parses the flags shared by the suites:
+// --csv, --json (one object per line), --max N, --ops N, --quick
+static void bench_args(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--csv"))
+      bench_fmt = BENCH_CSV;
+    else if (!strcmp(argv[i], "--json"))
+      bench_fmt = BENCH_JSON;
+    else if (!strcmp(argv[i], "--max") && i + 1 < argc)
+      bench_max = strtoull(argv[++i], NULL, 0);
+    else if (!strcmp(argv[i], "--ops") && i + 1 < argc)
+      bench_ops = strtoull(argv[++i], NULL, 0);
+    else if (!strcmp(argv[i], "--quick")) {
+      bench_max = 1 << 20;
+      bench_ops = 1 << 20;
+    } else {
+      fprintf(stderr,
+              "usage: %s [--csv|--json] [--max N] [--ops N] [--quick]\n",
+              argv[0]);
+      exit(1);
+    }
+  }
+  if (bench_fmt == BENCH_CSV)
+    printf("bench,variant,n,op,mops,ns_per_op,load\n");
+}
+
+// Reports `ops` operations of `op` that took `secs` on a table filled to
+// `load` (len / cap), or on anything else if `load` is negative
+static void bench_row_load(const char* bench, const char* variant, size_t n,
+                           const char* op, double ops, double secs,
+                           double load) {
+  double mops = ops / secs / 1e6;
+  double ns = secs / ops * 1e9;
+  char l[16] = "";
+  if (load >= 0)
+    snprintf(l, sizeof(l), "%.3f", load);
+  if (bench_fmt == BENCH_CSV)
+    printf("%s,%s,%zu,%s,%.3f,%.3f,%s\n", bench, variant, n, op, mops, ns, l);
+  else if (bench_fmt == BENCH_JSON)
+    printf("{\"bench\":\"%s\",\"variant\":\"%s\",\"n\":%zu,\"op\":\"%s\","
+           "\"mops\":%.3f,\"ns_per_op\":%.3f,\"load\":%s}\n",
+           bench, variant, n, op, mops, ns, load >= 0 ? l : "null");
+  else
+    printf("%-4s %-16s %10zu %-12s %9.2f Mops/s %8.2f ns %s\n", bench, variant,
+           n, op, mops, ns, l);
+  fflush(stdout);
+}
+
+static void bench_row(const char* bench, const char* variant, size_t n,
+                      const char* op, double ops, double secs) {
+  bench_row_load(bench, variant, n, op, ops, secs, -1);
+}
+
+// Sizes from L1 resident to far beyond the last level cache, up to bench_max
+static __attribute__((unused)) size_t bench_sizes[] = {
+    1 << 10, 1 << 14, 1 << 17, 1 << 20, 1 << 23, 1 << 26};
+#define bench_forsizes(n)                                                      \
+  for (size_t _s = 0, n;                                                       \
+       _s < sizeof(bench_sizes) / sizeof(*bench_sizes) &&                      \
+       (n = bench_sizes[_s]) <= bench_max;                                     \
+       _s++)
+
+// splitmix64 finalizer, a bijection so distinct inputs give distinct keys
+static unsigned long long bench_mix(unsigned long long x) {
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
@@ -0,0 +1,57 @@
+// Growth time and random lookup throughput of big ar.h arrays and ht.h tables.
+// Build with -DNO_BIGALLOC to compare against plain malloc/realloc.
+// usage: bigalloc_bench [n]
+
+#ifdef NO_BIGALLOC
+#  define AR_NO_BIGALLOC
+#  define HT_ALLOC(t, size) malloc(size)
+#  define HT_FREE(t, ptr, size) free(ptr)
+#endif
+
+#include "bench.h"
+
+#include "../ar.h"
+
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX ti
+#define HT_KEY_ATOMIC
+#define HT_KEY_EMPTY -1
+#define HT_KEY_GRAVE -2
+#include "../ht.h"
+
+int main(int argc, char** argv) {
+  int n = argc > 1 ? atoi(argv[1]) : 100000000;
+#ifdef NO_BIGALLOC
+  printf("malloc, n=%d\n", n);
+#else
+  printf("bigalloc, n=%d\n", n);
+#endif
+
+  u64* a;
+  arinit(a);
+  double t0 = now();
+  for (int i = 0; i < n; i++)
+    arpush(a, i);
+  double t1 = now();
+  escape(a);
+  arfree(a);
+  printf("ar push         %7.2f Mops/s\n", n / (t1 - t0) / 1e6);
+
+  struct ti_table t;
+  ti_init(&t);
+  t0 = now();
+  for (int i = 0; i < n; i++)
+    ti_insert(&t, i, i);
+  t1 = now();
+  unsigned long long s = 88172645463325252ull;
+  long sum = 0;
+  int lookups = 10000000;
+  for (int i = 0; i < lookups; i++)
+    sum += *ti_lookup(&t, bench_rand(&s) % n);
+  double t2 = now();
+  escape(&sum);
+  printf("ht insert       %7.2f Mops/s\n", n / (t1 - t0) / 1e6);
+  printf("ht random hit   %7.2f Mops/s\n", lookups / (t2 - t1) / 1e6);
+  ti_deinit(&t);
+}
@@ -0,0 +1,137 @@
+// Read-mostly maps of u64 -> u64: fm.h (Eytzinger order) against a sorted
+// array with binary search and ht.h. Builds each from n random keys, then
+// measures lookup hits, misses and ranges of 16 keys from a lower bound.
+// usage: fm_suite [--csv|--json] [--max N] [--ops N] [--quick]
+
+#include "bench.h"
+
+#define FM_KEY u64
+#define FM_VAL u64
+#define FM_PREFIX eytz
+#define FM_KEY_ATOMIC
+
+#include "../fm.h"
+
+#define HT_KEY u64
+#define HT_VAL u64
+#define HT_PREFIX hash
+#define HT_KEY_ATOMIC
+
+#define HT_KEY_EMPTY 0
+#define HT_KEY_GRAVE 1
+
+#include "../ht.h"
+
+#define RANGE 16
+
+static int cmp_u64(const void* a, const void* b) {
+  u64 x = *(const u64*)a, y = *(const u64*)b;
+  return x < y ? -1 : x > y;
+}
+
+// index of the first key >= k in the sorted `s`
+static size_t sorted_lower_bound(u64* s, size_t n, u64 k) {
+  size_t lo = 0, hi = n;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (s[mid] < k)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static void run(size_t n) {
+  u64* keys = malloc(sizeof(u64) * 2 * n);
+  for (size_t i = 0; i < 2 * n; i++)
+    keys[i] = bench_mix(i) | 2; // keys[n..2n) are misses
+  size_t reps = ds_max(bench_ops / n, (size_t)1);
+  double tb[3] = {0}, th[3] = {0}, tm[3] = {0}, tr[3] = {0};
+  u64 sum = 0;
+  for (size_t r = 0; r < reps; r++) {
+    // fm.h
+    struct eytz_map m;
+    double t0 = now();
+    eytz_build(&m, n, keys, keys);
+    double t1 = now();
+    for (size_t i = 0; i < n; i++)
+      sum += *eytz_lookup(&m, keys[i]);
+    double t2 = now();
+    for (size_t i = 0; i < n; i++)
+      sum += eytz_contains(&m, keys[n + i]);
+    double t3 = now();
+    for (size_t i = 0; i < n; i += RANGE) {
+      size_t j = 0;
+      fm_foreach_from(eytz, &m, eytz_lower_bound(&m, keys[n + i]), k, v) {
+        if (j++ == RANGE)
+          break;
+        sum += *v;
+      }
+    }
+    double t4 = now();
+    eytz_deinit(&m);
+    tb[0] += t1 - t0;
+    th[0] += t2 - t1;
+    tm[0] += t3 - t2;
+    tr[0] += t4 - t3;
+
+    // sorted array, values next to the keys would need a pair sort
+    t0 = now();
+    u64* s = malloc(sizeof(u64) * n);
+    memcpy(s, keys, sizeof(u64) * n);
+    qsort(s, n, sizeof(u64), cmp_u64);
+    t1 = now();
+    for (size_t i = 0; i < n; i++)
+      sum += s[sorted_lower_bound(s, n, keys[i])];
+    t2 = now();
+    for (size_t i = 0; i < n; i++) {
+      size_t j = sorted_lower_bound(s, n, keys[n + i]);
+      sum += j < n && s[j] == keys[n + i];
+    }
+    t3 = now();
+    for (size_t i = 0; i < n; i += RANGE) {
+      size_t j = sorted_lower_bound(s, n, keys[n + i]);
+      for (size_t e = ds_min(j + RANGE, n); j < e; j++)
+        sum += s[j];
+    }
+    t4 = now();
+    free(s);
+    tb[1] += t1 - t0;
+    th[1] += t2 - t1;
+    tm[1] += t3 - t2;
+    tr[1] += t4 - t3;
+
+    // ht.h, no ranges
+    struct hash_table t;
+    t0 = now();
+    hash_build(&t, n, keys, keys);
+    t1 = now();
+    for (size_t i = 0; i < n; i++)
+      sum += *hash_lookup(&t, keys[i]);
+    t2 = now();
+    for (size_t i = 0; i < n; i++)
+      sum += hash_contains(&t, keys[n + i]);
+    t3 = now();
+    hash_deinit(&t);
+    tb[2] += t1 - t0;
+    th[2] += t2 - t1;
+    tm[2] += t3 - t2;
+  }
+  escape(&sum);
+  free(keys);
+  double ops = (double)n * reps;
+  const char* names[] = {"eytzinger", "sorted", "ht"};
+  for (int v = 0; v < 3; v++) {
+    bench_row("fm", names[v], n, "build", ops, tb[v]);
+    bench_row("fm", names[v], n, "lookup_hit", ops, th[v]);
+    bench_row("fm", names[v], n, "lookup_miss", ops, tm[v]);
+    if (v < 2)
+      bench_row("fm", names[v], n, "range16", ops, tr[v]);
+  }
+}
+
+int main(int argc, char** argv) {
+  bench_args(argc, argv);
+  bench_forsizes(n) { run(n); }
+}
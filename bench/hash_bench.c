@@ -0,0 +1,32 @@
+#include "bench.h"
+
+#include "../hash.h"
+
+// Throughput of ds_hash_mem (djb2) and ds_hash_wy across key lengths.
+// usage: hash_bench [total MB per measurement]
+int main(int argc, char** argv) {
+  size_t total = (argc > 1 ? atoi(argv[1]) : 256) << 20;
+  size_t lens[] = {4, 8, 16, 32, 64, 128, 256, 1024, 4096};
+  char* buf = malloc(4096 + 64);
+  unsigned long long s = 88172645463325252ull;
+  for (size_t i = 0; i < 4096 + 64; i++)
+    buf[i] = bench_rand(&s);
+
+  printf("%6s %12s %12s\n", "len", "djb2 GB/s", "wy GB/s");
+  for (size_t l = 0; l < sizeof(lens) / sizeof(*lens); l++) {
+    size_t len = lens[l];
+    size_t n = total / len;
+    u64 sum = 0;
+    double t0 = now();
+    for (size_t i = 0; i < n; i++)
+      sum += ds_hash_mem(len, buf + (i & 63));
+    double t1 = now();
+    for (size_t i = 0; i < n; i++)
+      sum += ds_hash_wy(buf + (i & 63), len, 0);
+    double t2 = now();
+    escape(&sum);
+    printf("%6zu %12.2f %12.2f\n", len, total / (t1 - t0) / 1e9,
+           total / (t2 - t1) / 1e9);
+  }
+  free(buf);
+}
@@ -0,0 +1,105 @@
+// heap.h with 2 (binary heap), 4 and 8 children per node, for u64 and for 16
+// byte timer elements. Measures push and pop of n random elements, heapify of
+// n elements and hold (pop the smallest, push it back later) on a heap of n.
+// usage: heap_suite [--csv|--json] [--max N] [--ops N] [--quick]
+
+#include "bench.h"
+
+#include "../common.h"
+
+struct timer {
+  u64 deadline;
+  u64 id;
+};
+
+#define HEAP_PREFIX u64_2
+#define HEAP_TYPE u64
+#define HEAP_ARITY 2
+#include "../heap.h"
+
+#define HEAP_PREFIX u64_4
+#define HEAP_TYPE u64
+#define HEAP_ARITY 4
+#include "../heap.h"
+
+#define HEAP_PREFIX u64_8
+#define HEAP_TYPE u64
+#define HEAP_ARITY 8
+#include "../heap.h"
+
+#define HEAP_PREFIX tm_2
+#define HEAP_TYPE struct timer
+#define HEAP_LESS(a, b) ((a).deadline < (b).deadline)
+#define HEAP_ARITY 2
+#include "../heap.h"
+
+#define HEAP_PREFIX tm_4
+#define HEAP_TYPE struct timer
+#define HEAP_LESS(a, b) ((a).deadline < (b).deadline)
+#define HEAP_ARITY 4
+#include "../heap.h"
+
+#define HEAP_PREFIX tm_8
+#define HEAP_TYPE struct timer
+#define HEAP_LESS(a, b) ((a).deadline < (b).deadline)
+#define HEAP_ARITY 8
+#include "../heap.h"
+
+// MK(i) makes the element with deadline i, KEY(x) reads the deadline
+#define HEAP_RUN(prefix, T, MK, KEY, name, n)                                  \
+  do {                                                                         \
+    T* xs = malloc(sizeof(T) * n);                                             \
+    unsigned long long s = 88172645463325252ull;                               \
+    for (size_t i = 0; i < n; i++)                                             \
+      xs[i] = MK(bench_rand(&s) >> 16);                                        \
+    size_t reps = ds_max(bench_ops / n, (size_t)1);                            \
+    double tpush = 0, tpop = 0, tify = 0, thold = 0;                           \
+    u64 sum = 0;                                                               \
+    for (size_t r = 0; r < reps; r++) {                                        \
+      struct prefix##_heap h;                                                  \
+      prefix##_init(&h);                                                       \
+      double t0 = now();                                                       \
+      for (size_t i = 0; i < n; i++)                                           \
+        prefix##_push(&h, xs[i]);                                              \
+      double t1 = now();                                                       \
+      for (size_t i = 0; i < n; i++) { /* timers firing and rearming */        \
+        T x = prefix##_pop(&h);                                                \
+        prefix##_push(&h, MK(KEY(x) + (bench_rand(&s) >> 40)));                \
+      }                                                                        \
+      double t2 = now();                                                       \
+      for (size_t i = 0; i < n; i++)                                           \
+        sum += KEY(prefix##_pop(&h));                                          \
+      double t3 = now();                                                       \
+      prefix##_heapify(&h, xs, n);                                             \
+      double t4 = now();                                                       \
+      escape(&sum);                                                            \
+      prefix##_deinit(&h);                                                     \
+      tpush += t1 - t0;                                                        \
+      thold += t2 - t1;                                                        \
+      tpop += t3 - t2;                                                         \
+      tify += t4 - t3;                                                         \
+    }                                                                          \
+    free(xs);                                                                  \
+    double ops = (double)n * reps;                                             \
+    bench_row("heap", name, n, "push", ops, tpush);                            \
+    bench_row("heap", name, n, "hold", ops, thold);                            \
+    bench_row("heap", name, n, "pop", ops, tpop);                              \
+    bench_row("heap", name, n, "heapify", ops, tify);                          \
+  } while (0)
+
+#define MK_U64(i) ((u64)(i))
+#define KEY_U64(x) (x)
+#define MK_TM(i) ((struct timer){(i), 0})
+#define KEY_TM(x) ((x).deadline)
+
+int main(int argc, char** argv) {
+  bench_args(argc, argv);
+  bench_forsizes(n) {
+    HEAP_RUN(u64_2, u64, MK_U64, KEY_U64, "u64/2", n);
+    HEAP_RUN(u64_4, u64, MK_U64, KEY_U64, "u64/4", n);
+    HEAP_RUN(u64_8, u64, MK_U64, KEY_U64, "u64/8", n);
+    HEAP_RUN(tm_2, struct timer, MK_TM, KEY_TM, "timer16/2", n);
+    HEAP_RUN(tm_4, struct timer, MK_TM, KEY_TM, "timer16/4", n);
+    HEAP_RUN(tm_8, struct timer, MK_TM, KEY_TM, "timer16/8", n);
+  }
+}
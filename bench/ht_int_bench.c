@@ -0,0 +1,55 @@
+#include "bench.h"
+
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX ti
+#define HT_KEY_ATOMIC
+
+#define HT_KEY_EMPTY -1
+#define HT_KEY_GRAVE -2
+
+#include "../ht.h"
+
+// Insert and lookup throughput of an int -> int table.
+// usage: ht_int_bench [n] [seq]
+int main(int argc, char** argv) {
+  int n = argc > 1 ? atoi(argv[1]) : 1 << 20;
+  bool seq = argc > 2 && !strcmp(argv[2], "seq");
+  int* keys = malloc(sizeof(int) * n);
+  unsigned long long s = 88172645463325252ull;
+  for (int i = 0; i < n; i++)
+    keys[i] = seq ? i * 16 : bench_rand(&s) & 0x3fffffff;
+
+  struct ti_table t;
+  ti_init(&t);
+
+  double t0 = now();
+  for (int i = 0; i < n; i++)
+    ti_update(&t, keys[i], i);
+  double t1 = now();
+  long sum = 0;
+  for (int i = 0; i < n; i++)
+    sum += *ti_lookup(&t, keys[i]);
+  double t2 = now();
+  for (int i = 0; i < n; i++)
+    sum += ti_contains(&t, keys[i] | 0x40000000); // misses
+  double t3 = now();
+  int* out[256];
+  for (int i = 0; i < n; i += 256) {
+    int m = ds_min(n - i, 256);
+    ti_lookup_batch(&t, m, keys + i, out);
+    for (int j = 0; j < m; j++)
+      sum += *out[j];
+  }
+  double t4 = now();
+  escape(&sum);
+
+  printf("n=%d keys=%s len=%zu cap=%zu\n", n, seq ? "seq" : "rand", t.len, t.cap);
+  printf("insert      %7.2f Mops/s\n", n / (t1 - t0) / 1e6);
+  printf("lookup hit  %7.2f Mops/s\n", n / (t2 - t1) / 1e6);
+  printf("lookup miss %7.2f Mops/s\n", n / (t3 - t2) / 1e6);
+  printf("batch hit   %7.2f Mops/s\n", n / (t4 - t3) / 1e6);
+
+  ti_deinit(&t);
+  free(keys);
+}
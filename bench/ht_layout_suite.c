@@ -0,0 +1,169 @@
+// Split (keys and values in two arrays) against HT_LAYOUT_INLINE (one array of
+// key/value slots) for a few key and value sizes. Variants are named
+// key bytes:value bytes/layout.
+// usage: ht_layout_suite [--csv|--json] [--max N] [--ops N] [--quick]
+
+#include "bench.h"
+
+#include "../hash.h"
+
+struct pair {
+  u64 a, b;
+};
+
+struct v16 {
+  u64 a, b;
+};
+
+// 0 and 1 are the empty and grave keys
+#define U32_KEY(i) ((u32)bench_mix(i) | 2)
+#define ATOMIC_KEY(i) (bench_mix(i) | 2)
+#define PAIR_KEY(i) ((struct pair){bench_mix(i) | 2, i})
+#define V16(i) ((struct v16){i, i})
+
+#define HT_KEY u32
+#define HT_VAL u32
+#define HT_PREFIX k4v4_split
+#define HT_KEY_ATOMIC
+#define HT_KEY_EMPTY 0
+#define HT_KEY_GRAVE 1
+#include "../ht.h"
+#define RUN_PREFIX k4v4_split
+#define RUN_KEY(i) U32_KEY(i)
+#define RUN_NAME "4:4/split"
+#include "ht_run.h"
+
+#define HT_KEY u32
+#define HT_VAL u32
+#define HT_PREFIX k4v4_inline
+#define HT_KEY_ATOMIC
+#define HT_KEY_EMPTY 0
+#define HT_KEY_GRAVE 1
+#define HT_LAYOUT_INLINE
+#include "../ht.h"
+#define RUN_PREFIX k4v4_inline
+#define RUN_KEY(i) U32_KEY(i)
+#define RUN_NAME "4:4/inline"
+#include "ht_run.h"
+
+#define HT_KEY u64
+#define HT_VAL u32
+#define HT_PREFIX k8v4_split
+#define HT_KEY_ATOMIC
+#define HT_KEY_EMPTY 0
+#define HT_KEY_GRAVE 1
+#include "../ht.h"
+#define RUN_PREFIX k8v4_split
+#define RUN_KEY(i) ATOMIC_KEY(i)
+#define RUN_NAME "8:4/split"
+#include "ht_run.h"
+
+#define HT_KEY u64
+#define HT_VAL u32
+#define HT_PREFIX k8v4_inline
+#define HT_KEY_ATOMIC
+#define HT_KEY_EMPTY 0
+#define HT_KEY_GRAVE 1
+#define HT_LAYOUT_INLINE
+#include "../ht.h"
+#define RUN_PREFIX k8v4_inline
+#define RUN_KEY(i) ATOMIC_KEY(i)
+#define RUN_NAME "8:4/inline"
+#include "ht_run.h"
+
+#define HT_KEY u64
+#define HT_VAL u64
+#define HT_PREFIX k8v8_split
+#define HT_KEY_ATOMIC
+#define HT_KEY_EMPTY 0
+#define HT_KEY_GRAVE 1
+#include "../ht.h"
+#define RUN_PREFIX k8v8_split
+#define RUN_KEY(i) ATOMIC_KEY(i)
+#define RUN_NAME "8:8/split"
+#include "ht_run.h"
+
+#define HT_KEY u64
+#define HT_VAL u64
+#define HT_PREFIX k8v8_inline
+#define HT_KEY_ATOMIC
+#define HT_KEY_EMPTY 0
+#define HT_KEY_GRAVE 1
+#define HT_LAYOUT_INLINE
+#include "../ht.h"
+#define RUN_PREFIX k8v8_inline
+#define RUN_KEY(i) ATOMIC_KEY(i)
+#define RUN_NAME "8:8/inline"
+#include "ht_run.h"
+
+#define HT_KEY u64
+#define HT_VAL struct v16
+#define HT_PREFIX k8v16_split
+#define HT_KEY_ATOMIC
+#define HT_KEY_EMPTY 0
+#define HT_KEY_GRAVE 1
+#include "../ht.h"
+#define RUN_PREFIX k8v16_split
+#define RUN_KEY(i) ATOMIC_KEY(i)
+#define RUN_VAL(i) V16(i)
+#define RUN_GET(p) (p)->a
+#define RUN_NAME "8:16/split"
+#include "ht_run.h"
+
+#define HT_KEY u64
+#define HT_VAL struct v16
+#define HT_PREFIX k8v16_inline
+#define HT_KEY_ATOMIC
+#define HT_KEY_EMPTY 0
+#define HT_KEY_GRAVE 1
+#define HT_LAYOUT_INLINE
+#include "../ht.h"
+#define RUN_PREFIX k8v16_inline
+#define RUN_KEY(i) ATOMIC_KEY(i)
+#define RUN_VAL(i) V16(i)
+#define RUN_GET(p) (p)->a
+#define RUN_NAME "8:16/inline"
+#include "ht_run.h"
+
+#define HT_KEY struct pair
+#define HT_VAL u64
+#define HT_PREFIX k16v8_split
+#define HT_KEY_EMPTY ((struct pair){0, 0})
+#define HT_KEY_GRAVE ((struct pair){1, 0})
+#define HT_KEY_EQ(x, y) ((x).a == (y).a && (x).b == (y).b)
+#define HT_KEY_HASH(x) ds_hash_u64((x).a ^ ((x).b << 32))
+#include "../ht.h"
+#define RUN_PREFIX k16v8_split
+#define RUN_KEY(i) PAIR_KEY(i)
+#define RUN_NAME "16:8/split"
+#include "ht_run.h"
+
+#define HT_KEY struct pair
+#define HT_VAL u64
+#define HT_PREFIX k16v8_inline
+#define HT_KEY_EMPTY ((struct pair){0, 0})
+#define HT_KEY_GRAVE ((struct pair){1, 0})
+#define HT_KEY_EQ(x, y) ((x).a == (y).a && (x).b == (y).b)
+#define HT_KEY_HASH(x) ds_hash_u64((x).a ^ ((x).b << 32))
+#define HT_LAYOUT_INLINE
+#include "../ht.h"
+#define RUN_PREFIX k16v8_inline
+#define RUN_KEY(i) PAIR_KEY(i)
+#define RUN_NAME "16:8/inline"
+#include "ht_run.h"
+
+int main(int argc, char** argv) {
+  bench_args(argc, argv);
+  bench_forsizes(n) {
+    k4v4_split_run(n);
+    k4v4_inline_run(n);
+    k8v4_split_run(n);
+    k8v4_inline_run(n);
+    k8v8_split_run(n);
+    k8v8_inline_run(n);
+    k8v16_split_run(n);
+    k8v16_inline_run(n);
+    k16v8_split_run(n);
+    k16v8_inline_run(n);
+  }
+}
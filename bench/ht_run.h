@@ -0,0 +1,86 @@
+// Measurement loop for one generated table, included right after ht.h.
+//
+// RUN_PREFIX - HT_PREFIX of the table (ht.h undefines HT_PREFIX)
+// RUN_KEY(i) - the i-th distinct key as the table's key type
+// RUN_NAME   - variant name in the output
+// RUN_VAL(i) - value stored with the i-th key, `i` by default
+// RUN_GET(p) - number read from the value `p` points to, `*p` by default
+// RUN_SLOTS  - slots per unit of the table's `cap`, 1 by default
+
+#define R(x) ds_glue_expanded_(RUN_PREFIX, x)
+#ifndef RUN_VAL
+#  define RUN_VAL(i) (i)
+#endif
+#ifndef RUN_GET
+#  define RUN_GET(p) (*(p))
+#endif
+#ifndef RUN_SLOTS
+#  define RUN_SLOTS 1
+#endif
+
+// insert, lookup hit/miss, churn and remove. The tables get at least n keys,
+// then more until one more would grow them, so every HT_MAX_DENSITY is
+// measured at its own maximum load rather than at the load n happens to give.
+static void R(run)(size_t n) {
+  struct R(table) t;
+  R(init)(&t);
+  for (size_t i = 0; i < n; i++)
+    R(insert)(&t, RUN_KEY(i), RUN_VAL(i));
+  size_t cap = t.cap;
+  while (t.cap == cap) {
+    n = t.len;
+    R(insert)(&t, RUN_KEY(n), RUN_VAL(n));
+  }
+  R(deinit)(&t);
+  double load = (double)n / (cap * RUN_SLOTS);
+  R(_k)* keys = malloc(sizeof(*keys) * 2 * n);
+  for (size_t i = 0; i < 2 * n; i++)
+    keys[i] = RUN_KEY(i); // keys[n..2n) are misses until the churn
+  size_t reps = ds_max(bench_ops / n, (size_t)1);
+  double tin = 0, thit = 0, tmiss = 0, tchurn = 0, trm = 0;
+  size_t sum = 0;
+  for (size_t r = 0; r < reps; r++) {
+    R(init)(&t);
+    double t0 = now();
+    for (size_t i = 0; i < n; i++)
+      R(insert)(&t, keys[i], RUN_VAL(i));
+    double t1 = now();
+    for (size_t i = 0; i < n; i++)
+      sum += RUN_GET(R(lookup)(&t, keys[i]));
+    double t2 = now();
+    for (size_t i = 0; i < n; i++)
+      sum += R(contains)(&t, keys[n + i]);
+    double t3 = now();
+    bool b;
+    for (size_t i = 0; i < n; i++) { // replace every key, size stays the same
+      R(remove)(&t, keys[i], &b);
+      R(insert)(&t, keys[n + i], RUN_VAL(i));
+    }
+    double t4 = now();
+    for (size_t i = 0; i < n; i++)
+      R(remove)(&t, keys[n + i], &b);
+    double t5 = now();
+    escape(&sum);
+    R(deinit)(&t);
+    tin += t1 - t0;
+    thit += t2 - t1;
+    tmiss += t3 - t2;
+    tchurn += t4 - t3;
+    trm += t5 - t4;
+  }
+  double ops = (double)n * reps;
+  bench_row_load("ht", RUN_NAME, n, "insert", ops, tin, load);
+  bench_row_load("ht", RUN_NAME, n, "lookup_hit", ops, thit, load);
+  bench_row_load("ht", RUN_NAME, n, "lookup_miss", ops, tmiss, load);
+  bench_row_load("ht", RUN_NAME, n, "churn", ops, tchurn, load);
+  bench_row_load("ht", RUN_NAME, n, "remove", ops, trm, load);
+  free(keys);
+}
+
+#undef R
+#undef RUN_PREFIX
+#undef RUN_KEY
+#undef RUN_NAME
+#undef RUN_VAL
+#undef RUN_GET
+#undef RUN_SLOTS
@@ -0,0 +1,190 @@
+// Throughput of ht.h (and htb.h) across key modes, table sizes and
+// HT_MAX_DENSITY.
+// usage: ht_suite [--csv|--json] [--max N] [--ops N] [--quick]
+
+#include "bench.h"
+
+#include "../hash.h"
+
+// 16 byte keys for HT_KEY_MEM, the table stores pointers to them
+#define MEM_LEN 16
+static char (*mem_keys)[MEM_LEN];
+
+static char* mem_key(size_t i) {
+  unsigned long long a = bench_mix(i), b = bench_mix(a);
+  memcpy(mem_keys[i], &a, 8);
+  memcpy(mem_keys[i] + 8, &b, 8);
+  return mem_keys[i];
+}
+
+struct pair {
+  u64 a, b;
+};
+
+// 0 and 1 are the empty and grave keys
+#define ATOMIC_KEY(i) (bench_mix(i) | 2)
+#define PAIR_KEY(i) ((struct pair){bench_mix(i) | 2, i})
+
+#define HT_KEY u64
+#define HT_VAL size_t
+#define HT_PREFIX atomic50
+#define HT_KEY_ATOMIC
+#define HT_KEY_EMPTY 0
+#define HT_KEY_GRAVE 1
+#define HT_MAX_DENSITY 0.5
+#include "../ht.h"
+#define RUN_PREFIX atomic50
+#define RUN_KEY(i) ATOMIC_KEY(i)
+#define RUN_NAME "atomic/0.5"
+#include "ht_run.h"
+
+#define HT_KEY u64
+#define HT_VAL size_t
+#define HT_PREFIX atomic75
+#define HT_KEY_ATOMIC
+#define HT_KEY_EMPTY 0
+#define HT_KEY_GRAVE 1
+#define HT_MAX_DENSITY 0.75
+#include "../ht.h"
+#define RUN_PREFIX atomic75
+#define RUN_KEY(i) ATOMIC_KEY(i)
+#define RUN_NAME "atomic/0.75"
+#include "ht_run.h"
+
+#define HT_KEY u64
+#define HT_VAL size_t
+#define HT_PREFIX atomic88
+#define HT_KEY_ATOMIC
+#define HT_KEY_EMPTY 0
+#define HT_KEY_GRAVE 1
+#define HT_MAX_DENSITY 0.875
+#include "../ht.h"
+#define RUN_PREFIX atomic88
+#define RUN_KEY(i) ATOMIC_KEY(i)
+#define RUN_NAME "atomic/0.875"
+#include "ht_run.h"
+
+#define HT_KEY u64
+#define HT_VAL size_t
+#define HT_PREFIX cuckoo90
+#define HT_KEY_ATOMIC
+#include "../htb.h"
+#define RUN_PREFIX cuckoo90
+#define RUN_KEY(i) ATOMIC_KEY(i)
+#define RUN_NAME "cuckoo4/0.9"
+#define RUN_SLOTS 4
+#include "ht_run.h"
+
+#define HT_KEY u64
+#define HT_VAL size_t
+#define HT_PREFIX cuckoo95
+#define HT_KEY_ATOMIC
+#define HT_BUCKET 7 // denser, but a bucket spans two cache lines
+#define HT_MAX_DENSITY 0.95
+#include "../htb.h"
+#define RUN_PREFIX cuckoo95
+#define RUN_KEY(i) ATOMIC_KEY(i)
+#define RUN_NAME "cuckoo7/0.95"
+#define RUN_SLOTS 7
+#include "ht_run.h"
+
+#define HT_KEY char*
+#define HT_VAL size_t
+#define HT_PREFIX mem50
+#define HT_KEY_MEM
+#define HT_KEY_LEN MEM_LEN
+#define HT_CTRL // pointer keys don't have spare sentinel values
+#define HT_MAX_DENSITY 0.5
+#include "../ht.h"
+#define RUN_PREFIX mem50
+#define RUN_KEY(i) mem_key(i)
+#define RUN_NAME "mem16/0.5"
+#include "ht_run.h"
+
+#define HT_KEY char*
+#define HT_VAL size_t
+#define HT_PREFIX mem75
+#define HT_KEY_MEM
+#define HT_KEY_LEN MEM_LEN
+#define HT_CTRL // pointer keys don't have spare sentinel values
+#define HT_MAX_DENSITY 0.75
+#include "../ht.h"
+#define RUN_PREFIX mem75
+#define RUN_KEY(i) mem_key(i)
+#define RUN_NAME "mem16/0.75"
+#include "ht_run.h"
+
+#define HT_KEY char*
+#define HT_VAL size_t
+#define HT_PREFIX mem88
+#define HT_KEY_MEM
+#define HT_KEY_LEN MEM_LEN
+#define HT_CTRL // pointer keys don't have spare sentinel values
+#define HT_MAX_DENSITY 0.875
+#include "../ht.h"
+#define RUN_PREFIX mem88
+#define RUN_KEY(i) mem_key(i)
+#define RUN_NAME "mem16/0.875"
+#include "ht_run.h"
+
+#define HT_KEY struct pair
+#define HT_VAL size_t
+#define HT_PREFIX pair50
+#define HT_KEY_EMPTY ((struct pair){0, 0})
+#define HT_KEY_GRAVE ((struct pair){1, 0})
+#define HT_KEY_EQ(x, y) ((x).a == (y).a && (x).b == (y).b)
+#define HT_KEY_HASH(x) ds_hash_u64((x).a ^ ((x).b << 32))
+#define HT_MAX_DENSITY 0.5
+#include "../ht.h"
+#define RUN_PREFIX pair50
+#define RUN_KEY(i) PAIR_KEY(i)
+#define RUN_NAME "struct/0.5"
+#include "ht_run.h"
+
+#define HT_KEY struct pair
+#define HT_VAL size_t
+#define HT_PREFIX pair75
+#define HT_KEY_EMPTY ((struct pair){0, 0})
+#define HT_KEY_GRAVE ((struct pair){1, 0})
+#define HT_KEY_EQ(x, y) ((x).a == (y).a && (x).b == (y).b)
+#define HT_KEY_HASH(x) ds_hash_u64((x).a ^ ((x).b << 32))
+#define HT_MAX_DENSITY 0.75
+#include "../ht.h"
+#define RUN_PREFIX pair75
+#define RUN_KEY(i) PAIR_KEY(i)
+#define RUN_NAME "struct/0.75"
+#include "ht_run.h"
+
+#define HT_KEY struct pair
+#define HT_VAL size_t
+#define HT_PREFIX pair88
+#define HT_KEY_EMPTY ((struct pair){0, 0})
+#define HT_KEY_GRAVE ((struct pair){1, 0})
+#define HT_KEY_EQ(x, y) ((x).a == (y).a && (x).b == (y).b)
+#define HT_KEY_HASH(x) ds_hash_u64((x).a ^ ((x).b << 32))
+#define HT_MAX_DENSITY 0.875
+#include "../ht.h"
+#define RUN_PREFIX pair88
+#define RUN_KEY(i) PAIR_KEY(i)
+#define RUN_NAME "struct/0.875"
+#include "ht_run.h"
+
+int main(int argc, char** argv) {
+  bench_args(argc, argv);
+  // the runs fill up to twice bench_max keys and use as many misses
+  mem_keys = malloc(MEM_LEN * 4 * bench_max);
+  bench_forsizes(n) {
+    atomic50_run(n);
+    atomic75_run(n);
+    atomic88_run(n);
+    cuckoo90_run(n);
+    cuckoo95_run(n);
+    mem50_run(n);
+    mem75_run(n);
+    mem88_run(n);
+    pair50_run(n);
+    pair75_run(n);
+    pair88_run(n);
+  }
+  free(mem_keys);
+}
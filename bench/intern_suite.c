@@ -0,0 +1,100 @@
+// Deduplicating identifiers: intern.h one at a time and in bulk against xstrdup
+// plus an ht.h HT_KEY_STRPTR table, the way it's done without intern.h. Every
+// one of n/4 distinct names of 6 to 21 bytes shows up 4 times in random order.
+// Measures interning all n, then looking all n up again.
+// usage: intern_suite [--csv|--json] [--max N] [--ops N] [--quick]
+
+#include "bench.h"
+
+#include "../ar.h"
+#include "../intern.h"
+#include "../x.h"
+
+#define HT_PREFIX dup
+#define HT_VAL u32
+#define HT_KEY_STRPTR
+
+#include "../ht.h"
+
+static void run(size_t n) {
+  // names[i] is distinct name `bench_mix(i) % (n / 4)`
+  size_t distinct = ds_max(n / 4, (size_t)1);
+  char* chars = malloc(32 * n);
+  const char** names = malloc(sizeof(char*) * n);
+  for (size_t i = 0; i < n; i++) {
+    u64 d = bench_mix(i) % distinct;
+    names[i] = chars + 32 * i;
+    snprintf(chars + 32 * i, 32, "%.*s_%llx", (int)(d % 8), "fn_var_",
+             (unsigned long long)bench_mix(d) >> (d % 32));
+  }
+  size_t reps = ds_max(bench_ops / n, (size_t)1);
+  double ti[3] = {0}, tl[3] = {0};
+  u32* ids = malloc(sizeof(u32) * n);
+  u64 sum = 0;
+  for (size_t r = 0; r < reps; r++) {
+    // xstrdup + HT_KEY_STRPTR, with an array for id -> string
+    struct dup_table t;
+    char** strs;
+    double t0 = now();
+    dup_init(&t);
+    arinit(strs);
+    for (size_t i = 0; i < n; i++) {
+      u32* id = dup_lookup(&t, names[i]);
+      if (!id) {
+        char* s = xstrdup((char*)names[i]);
+        arpush(strs, s);
+        dup_insert(&t, s, arlen(strs) - 1);
+      }
+    }
+    double t1 = now();
+    for (size_t i = 0; i < n; i++)
+      sum += *dup_lookup(&t, names[i]);
+    double t2 = now();
+    arforei(strs, i) xfree(strs[i]);
+    arfree(strs);
+    dup_deinit(&t);
+    ti[0] += t1 - t0;
+    tl[0] += t2 - t1;
+
+    // intern.h
+    struct ds_intern in;
+    t0 = now();
+    ds_intern_init(&in);
+    for (size_t i = 0; i < n; i++)
+      sum += ds_intern(&in, names[i]);
+    t1 = now();
+    for (size_t i = 0; i < n; i++)
+      sum += ds_intern_find(&in, names[i], strlen(names[i]));
+    t2 = now();
+    ds_intern_deinit(&in);
+    ti[1] += t1 - t0;
+    tl[1] += t2 - t1;
+
+    // intern.h bulk, lookups are ds_intern_bulk on interned strings
+    t0 = now();
+    ds_intern_init(&in);
+    ds_intern_bulk(&in, n, names, NULL, ids);
+    t1 = now();
+    ds_intern_bulk(&in, n, names, NULL, ids);
+    t2 = now();
+    sum += ids[n - 1];
+    ds_intern_deinit(&in);
+    ti[2] += t1 - t0;
+    tl[2] += t2 - t1;
+  }
+  escape(&sum);
+  free(ids);
+  free(names);
+  free(chars);
+  double ops = (double)n * reps;
+  const char* variants[] = {"xstrdup+ht", "intern", "intern_bulk"};
+  for (int v = 0; v < 3; v++) {
+    bench_row("intern", variants[v], n, "intern", ops, ti[v]);
+    bench_row("intern", variants[v], n, "lookup", ops, tl[v]);
+  }
+}
+
+int main(int argc, char** argv) {
+  bench_args(argc, argv);
+  bench_forsizes(n) { run(n); }
+}
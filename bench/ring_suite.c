@@ -0,0 +1,203 @@
+// Handing u64 items between threads: ring.h SPSC and MPMC against an ar.h
+// array under a mutex. Measures throughput of 1 producer + 1 consumer (and 2 +
+// 2 where the queue allows it) with one item per call and with batches of 32,
+// and the round trip of one item bounced between two threads over two queues.
+// Waiting threads spin briefly, then yield, so it also runs on few cores.
+// usage: ring_suite [--csv|--json] [--ops N] [--quick]
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "bench.h"
+
+#include "../ar.h"
+
+#define RING_PREFIX spsc
+#define RING_TYPE u64
+
+#include "../ring.h"
+
+#define RING_PREFIX mpmc
+#define RING_TYPE u64
+#define RING_MPMC
+
+#include "../ring.h"
+
+#define CAP 1024
+#define BATCH 32
+
+// The baseline: an ar.h array and a read index under a mutex, bounded to CAP
+// like the rings.
+struct locked_ring {
+  pthread_mutex_t lock;
+  u64* a;
+  size_t rd; // next element to pop
+};
+
+static void locked_init(struct locked_ring* q, size_t cap) {
+  pthread_mutex_init(&q->lock, NULL);
+  arinit(q->a);
+  q->rd = 0;
+}
+
+static void locked_deinit(struct locked_ring* q) {
+  arfree(q->a);
+  pthread_mutex_destroy(&q->lock);
+}
+
+static size_t locked_push_n(struct locked_ring* q, const u64* xs, size_t n) {
+  pthread_mutex_lock(&q->lock);
+  n = ds_min(n, CAP - (arlen(q->a) - q->rd));
+  memcpy(arpushm(q->a, n), xs, sizeof(u64) * n);
+  pthread_mutex_unlock(&q->lock);
+  return n;
+}
+
+static size_t locked_pop_n(struct locked_ring* q, u64* out, size_t n) {
+  pthread_mutex_lock(&q->lock);
+  n = ds_min(n, arlen(q->a) - q->rd);
+  memcpy(out, q->a + q->rd, sizeof(u64) * n);
+  q->rd += n;
+  if (q->rd == arlen(q->a)) {
+    ds_skip_back(struct ar_head, elms, q->a)->len = 0;
+    q->rd = 0;
+  }
+  pthread_mutex_unlock(&q->lock);
+  return n;
+}
+
+// spins a little, then gives the core away
+static void backoff(unsigned* spins) {
+  if (++*spins < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+  } else
+    sched_yield();
+}
+
+struct job {
+  void* q;
+  void* back; // second queue of the round trip
+  size_t items;
+  size_t batch;
+  u64 sum;
+};
+
+// producer, consumer and echo (pop from `q`, push back to `back`) threads
+#define RING_THREADS(prefix)                                                   \
+  static void* prefix##_producer(void* arg) {                                  \
+    struct job* j = arg;                                                       \
+    u64 xs[BATCH];                                                             \
+    unsigned spins = 0;                                                        \
+    for (size_t i = 0; i < j->items;) {                                        \
+      size_t n = ds_min(j->batch, j->items - i);                               \
+      for (size_t k = 0; k < n; k++)                                           \
+        xs[k] = i + k;                                                         \
+      size_t k = prefix##_push_n(j->q, xs, n);                                 \
+      if (!k)                                                                  \
+        backoff(&spins);                                                       \
+      else                                                                     \
+        spins = 0;                                                             \
+      i += k;                                                                  \
+    }                                                                          \
+    return NULL;                                                               \
+  }                                                                            \
+  static void* prefix##_consumer(void* arg) {                                  \
+    struct job* j = arg;                                                       \
+    u64 xs[BATCH];                                                             \
+    unsigned spins = 0;                                                        \
+    for (size_t i = 0; i < j->items;) {                                        \
+      size_t k = prefix##_pop_n(j->q, xs, ds_min(j->batch, j->items - i));     \
+      if (!k)                                                                  \
+        backoff(&spins);                                                       \
+      else                                                                     \
+        spins = 0;                                                             \
+      for (size_t n = 0; n < k; n++)                                           \
+        j->sum += xs[n];                                                       \
+      i += k;                                                                  \
+    }                                                                          \
+    return NULL;                                                               \
+  }                                                                            \
+  static void* prefix##_echo(void* arg) {                                      \
+    struct job* j = arg;                                                       \
+    unsigned spins = 0;                                                        \
+    for (size_t i = 0; i < j->items; i++) {                                    \
+      u64 x;                                                                   \
+      while (!prefix##_pop_n(j->q, &x, 1))                                     \
+        backoff(&spins);                                                       \
+      while (!prefix##_push_n(j->back, &x, 1))                                 \
+        backoff(&spins);                                                       \
+    }                                                                          \
+    return NULL;                                                               \
+  }
+
+RING_THREADS(spsc)
+RING_THREADS(mpmc)
+RING_THREADS(locked)
+
+// `np` producers and as many consumers pass bench_ops items in batches of `b`
+#define RING_RUN(prefix, name, np, b, op)                                      \
+  do {                                                                         \
+    struct prefix##_ring q;                                                    \
+    prefix##_init(&q, CAP);                                                    \
+    struct job jobs[2 * np];                                                   \
+    pthread_t th[2 * np];                                                      \
+    size_t items = bench_ops / np;                                             \
+    double t0 = now();                                                         \
+    for (int i = 0; i < np; i++) {                                             \
+      jobs[i] = jobs[np + i] = (struct job){&q, NULL, items, b, 0};            \
+      pthread_create(&th[i], NULL, prefix##_producer, &jobs[i]);               \
+      pthread_create(&th[np + i], NULL, prefix##_consumer, &jobs[np + i]);     \
+    }                                                                          \
+    for (int i = 0; i < 2 * np; i++)                                           \
+      pthread_join(th[i], NULL);                                               \
+    double t1 = now();                                                         \
+    for (int i = 0; i < np; i++)                                               \
+      escape(&jobs[np + i].sum);                                               \
+    prefix##_deinit(&q);                                                       \
+    bench_row("ring", name, CAP, op, (double)items * np, t1 - t0);             \
+  } while (0)
+
+// round trips of a single item, every one waits for the previous
+#define RING_RTT(prefix, name)                                                 \
+  do {                                                                         \
+    struct prefix##_ring there, back;                                          \
+    prefix##_init(&there, CAP);                                                \
+    prefix##_init(&back, CAP);                                                 \
+    size_t items = ds_max(bench_ops / 64, (size_t)1);                          \
+    struct job j = {&there, &back, items, 1, 0};                               \
+    pthread_t th;                                                              \
+    pthread_create(&th, NULL, prefix##_echo, &j);                              \
+    unsigned spins = 0;                                                        \
+    double t0 = now();                                                         \
+    for (u64 i = 0; i < items; i++) {                                          \
+      u64 x = i;                                                               \
+      while (!prefix##_push_n(&there, &x, 1))                                  \
+        backoff(&spins);                                                       \
+      while (!prefix##_pop_n(&back, &x, 1))                                    \
+        backoff(&spins);                                                       \
+    }                                                                          \
+    double t1 = now();                                                         \
+    pthread_join(th, NULL);                                                    \
+    prefix##_deinit(&there);                                                   \
+    prefix##_deinit(&back);                                                    \
+    bench_row("ring", name, CAP, "round_trip", (double)items, t1 - t0);        \
+  } while (0)
+
+int main(int argc, char** argv) {
+  bench_args(argc, argv);
+  RING_RUN(spsc, "spsc", 1, 1, "handoff");
+  RING_RUN(spsc, "spsc", 1, BATCH, "handoff_b32");
+  RING_RTT(spsc, "spsc");
+  RING_RUN(mpmc, "mpmc", 1, 1, "handoff");
+  RING_RUN(mpmc, "mpmc", 1, BATCH, "handoff_b32");
+  RING_RUN(mpmc, "mpmc/2+2", 2, 1, "handoff");
+  RING_RUN(mpmc, "mpmc/2+2", 2, BATCH, "handoff_b32");
+  RING_RTT(mpmc, "mpmc");
+  RING_RUN(locked, "mutex+ar", 1, 1, "handoff");
+  RING_RUN(locked, "mutex+ar", 1, BATCH, "handoff_b32");
+  RING_RUN(locked, "mutex+ar/2+2", 2, 1, "handoff");
+  RING_RUN(locked, "mutex+ar/2+2", 2, BATCH, "handoff_b32");
+  RING_RTT(locked, "mutex+ar");
+}
@@ -0,0 +1,108 @@
+#ifndef DS_BIGALLOC_H
+#define DS_BIGALLOC_H
+
+#include "common.h"
+#include "x.h"
+
+#include <string.h>
+
+/*
+ * Allocator for big arrays. Allocations of at least DS_BIG_THRESHOLD bytes are
+ * anonymous mappings: growing them with mremap moves page table entries
+ * instead of copying the data, and they ask for transparent huge pages so
+ * random access into them doesn't thrash the TLB. Smaller allocations go to
+ * malloc. ar.h and ht.h use it by default.
+ *
+ * Every call has to be given the size the block currently has, that's how
+ * mapped blocks are told apart from malloc'd ones.
+ *
+ * Everywhere except Linux this is just malloc, realloc and free.
+ */
+
+#ifndef DS_BIG_THRESHOLD
+#  define DS_BIG_THRESHOLD (4ul << 20)
+#endif
+
+#ifdef __linux__
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+
+// mremap is only declared with _GNU_SOURCE, which has to come before the first
+// system header, so go through syscall.
+#  define DS_MREMAP_MAYMOVE 1
+
+static size_t ds_big_round(size_t size) {
+  size_t page = 4096;
+  return (size + page - 1) & ~(page - 1);
+}
+
+static void* ds_big_map(size_t size) {
+  void* p = mmap(NULL, ds_big_round(size), PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED)
+    __builtin_trap();
+#  ifdef MADV_HUGEPAGE
+  madvise(p, ds_big_round(size), MADV_HUGEPAGE);
+#  endif
+  return p;
+}
+
+static void* ds_big_alloc(size_t size) {
+  return size < DS_BIG_THRESHOLD ? xmalloc(size) : ds_big_map(size);
+}
+
+static void ds_big_free(void* p, size_t size) {
+  if (size < DS_BIG_THRESHOLD)
+    xfree(p);
+  else if (p)
+    munmap(p, ds_big_round(size));
+}
+
+/**
+ * realloc of a block of `old` bytes. `p` can be NULL (with `old` 0), size 0
+ * frees the block.
+ */
+static void* ds_big_realloc(void* p, size_t old, size_t size) {
+  if (!p)
+    return size ? ds_big_alloc(size) : NULL;
+  if (!size) {
+    ds_big_free(p, old);
+    return NULL;
+  }
+  bool was_big = old >= DS_BIG_THRESHOLD;
+  bool is_big = size >= DS_BIG_THRESHOLD;
+  if (!was_big && !is_big)
+    return xrealloc(p, size);
+  if (was_big && is_big) {
+    if (ds_big_round(old) == ds_big_round(size))
+      return p;
+    void* n = (void*)syscall(SYS_mremap, p, ds_big_round(old),
+                             ds_big_round(size), DS_MREMAP_MAYMOVE);
+    if (n == MAP_FAILED)
+      __builtin_trap();
+    // the pages added at the end of the mapping aren't advised yet
+#  ifdef MADV_HUGEPAGE
+    madvise(n, ds_big_round(size), MADV_HUGEPAGE);
+#  endif
+    return n;
+  }
+  // crossing the threshold, copy once
+  void* n = ds_big_alloc(size);
+  memcpy(n, p, ds_min(old, size));
+  ds_big_free(p, old);
+  return n;
+}
+#else
+static void* ds_big_alloc(size_t size) { return xmalloc(size); }
+static void ds_big_free(void* p, ds_unused size_t size) { xfree(p); }
+static void* ds_big_realloc(void* p, ds_unused size_t old, size_t size) {
+  if (!size) {
+    xfree(p);
+    return NULL;
+  }
+  return xrealloc(p, size);
+}
+#endif
+
+#endif
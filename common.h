@@ -35,4 +35,6 @@ typedef unsigned int uint;
 #define ds_likely(x) __builtin_expect((x), 1)
 #define ds_unlikely(x) __builtin_expect((x), 0)
 
+#define ds_prefetch(p) __builtin_prefetch(p)
+
 #endif
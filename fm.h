@@ -0,0 +1,447 @@
+#include "ar.h"
+#include "common.h"
+
+#include <assert.h>
+#include <string.h>
+
+#ifndef fm_foreach
+// Loops over map `m` made with FM_PREFIX `prefix` in key order, `k` and `v`
+// point to the key and value of each pair.
+#  define fm_foreach(prefix, m, k, v)                                          \
+    fm_foreach_from(prefix, m, ds_glue_expanded_(prefix, first)(m), k, v)
+
+// Like fm_foreach but starts at position `pos`, e.g. from lower_bound.
+#  define fm_foreach_from(prefix, m, pos, k, v)                                \
+    for (size_t _it = (pos), _k = 1; _k; _k = 0)                               \
+      for (ds_glue_expanded_(prefix, _k)* k; _k; _k = 0)                       \
+        for (ds_glue_expanded_(prefix, _v)* v;                                 \
+             ds_glue_expanded_(prefix, next)(m, &_it, &k, &v);)
+#endif
+
+#ifndef fm_foreach_key
+// fm_foreach for sets (FM_VAL left out), `k` points to each key.
+#  define fm_foreach_key(prefix, m, k)                                         \
+    for (size_t _it = ds_glue_expanded_(prefix, first)(m), _k = 1; _k; _k = 0) \
+      for (ds_glue_expanded_(prefix, _k)* k;                                   \
+           ds_glue_expanded_(prefix, next)(m, &_it, &k);)
+#endif
+
+/*
+ * # Sorted flat map generator header
+ *
+ * ## Usage
+ *
+ * For maps that are built once and then only read. Pairs are collected with
+ * `add` and `finalize` sorts them into two dense arrays, so the map takes
+ * (n + 1) * (sizeof(K) + sizeof(V)) bytes with no empty slots. Lookups take
+ * about log2(n) key compares without branch mispredictions, and the keys can
+ * be walked in order or from any key on (range queries).
+ *
+ * ```c
+ * #define FM_PREFIX dict
+ * #define FM_KEY u64
+ * #define FM_VAL u32
+ * #define FM_KEY_ATOMIC
+ * #include "fm.h"
+ *
+ * struct dict_map m;
+ * dict_init(&m);
+ * dict_add(&m, 10, 1);
+ * dict_add(&m, 20, 2);
+ * dict_finalize(&m);
+ * u32* v = dict_lookup(&m, 20);
+ * fm_foreach_from(dict, &m, dict_lower_bound(&m, 15), k, v) {
+ *   if (!dict_less(*k, 30))
+ *     break;
+ *   ...
+ * }
+ * ```
+ *
+ * ## Internal workings
+ *
+ * The sorted keys are stored in Eytzinger order: index 1 is the root of an
+ * implicit binary search tree and the children of `i` are `2i` and `2i + 1`,
+ * like in a binary heap. The search steps `i = 2i + (key[i] < k)` have no
+ * branch to mispredict, and the 2^d descendants of `i` that are d levels
+ * further down sit next to each other, so prefetching the ones that fill a
+ * cache line hides the latency of the next d levels. The lower bound is
+ * recovered from the final `i` by dropping its trailing ones.
+ *
+ * Positions (indices into the arrays) are the cursors, 0 means "no key".
+ * `succ` and `pred` step to the neighbouring keys in order in amortized O(1).
+ *
+ * Pairs added after `finalize` are invisible until the next `finalize`, which
+ * merges them in and lays the whole map out again.
+ *
+ * ## Required macros
+ *
+ * FM_PREFIX - value of this is used as the prefix for all functions
+ *
+ * FM_KEY - the key type
+ * FM_VAL - the value type. Leave it out to get a sorted set: `add` and `next`
+ *          take only the key, `lookup` is not there and `fm_foreach_key`
+ *          loops over the keys.
+ *
+ * ### Macros that define how to compare keys
+ *
+ * Macro         | Compare | Note
+ * --------------|---------|-------
+ * FM_KEY_ATOMIC | `<`     | `int`, `double`, `u64`, ...
+ * FM_KEY_MEM    | memcmp  | FM_KEY_LEN required. (key is char*)
+ * FM_KEY_STR    | strncmp | FM_KEY_LEN required. (key is char[N], `P(str)`)
+ * FM_KEY_LESS   | custom  | FM_KEY_LESS(a, b) is a < b
+ *
+ * ### Switches
+ *
+ * FM_ALLOC(m, size), FM_FREE(m, ptr, size) - Allocator of the finalized
+ *                arrays, 64 byte aligned aligned_alloc by default
+ * FM_MAP_EXTRA_VARS - Extra fields of the map struct, e.g. for FM_ALLOC
+ * FM_FUNC_ATTR - Attributes of all functions, e.g. `static inline`
+ *
+ * ### Functions
+ *
+ * Function    | Description
+ * ------------|----
+ * init        | Init an empty map
+ * deinit      | Free memory used by a map
+ * add         | Add a pair, visible after the next finalize. Of duplicate
+ *             | keys the first one added is kept.
+ * finalize    | Sort the added pairs into the map
+ * build       | init + add of arrays of keys and values + finalize
+ *
+ * lookup      | Pointer to the value under a key or NULL
+ * contains    | Whether a key is present
+ * lower_bound | Position of the first key >= k
+ * upper_bound | Position of the first key > k
+ * first, last | Position of the smallest and the largest key
+ * succ, pred  | Position of the next and the previous key
+ * next        | Cursor from a position on, see also `fm_foreach`
+ * less        | The key order
+ */
+
+#if !defined(FM_KEY) && !defined(FM_KEY_STR)
+#  error You have to define FM_KEY
+#endif
+
+#ifndef FM_VAL
+#  define FM_SET
+#endif
+
+#ifndef FM_ALLOC
+// Allocates the finalized arrays of map `m`
+#  define FM_ALLOC(m, size) aligned_alloc(64, ((size) + 63) & ~(size_t)63)
+#endif
+
+#ifndef FM_FREE
+// Frees arrays allocated by FM_ALLOC
+#  define FM_FREE(m, ptr, size) free(ptr)
+#endif
+
+#ifndef FM_FUNC_ATTR
+#  define FM_FUNC_ATTR
+#endif
+
+#define P(x) ds_glue_expanded_(FM_PREFIX, x)
+
+#if defined(FM_KEY_STR) && !defined(FM_KEY)
+typedef char P(str)[FM_KEY_LEN];
+#  define FM_KEY P(str)
+#endif
+
+// shortcuts
+#define K FM_KEY
+#ifdef FM_SET
+#  define VAL(...) // sets have no values
+#else
+#  define V FM_VAL
+#  define VAL(...) __VA_ARGS__
+#endif
+#ifdef FM_KEY_STR
+#  define KEY_PTR(k) (k) // array parameters are already pointers
+#else
+#  define KEY_PTR(k) (&(k))
+#endif
+
+// Descendants of a node this many levels down are contiguous, prefetching the
+// first of them pulls in the cache line with all of them.
+#define PF                                                                     \
+  (sizeof(K) <= 4    ? 16                                                      \
+   : sizeof(K) <= 8  ? 8                                                       \
+   : sizeof(K) <= 16 ? 4                                                       \
+   : sizeof(K) <= 32 ? 2                                                       \
+                     : 1)
+
+#define M struct P(map)
+
+typedef K P(_k); // for fm_foreach
+VAL(typedef V P(_v);)
+
+struct P(map) {
+  size_t len; // number of finalized pairs
+  K* keys;    // Eytzinger order starting at index 1, NULL when empty
+  VAL(V* vals;)
+  K* add_keys; // ar.h arrays of the pairs added since finalize, or NULL
+  VAL(V* add_vals;)
+#ifdef FM_MAP_EXTRA_VARS
+  FM_MAP_EXTRA_VARS
+#endif
+};
+
+FM_FUNC_ATTR bool P(less)(K a, K b) {
+#if defined(FM_KEY_LESS)
+  return FM_KEY_LESS(a, b);
+#elif defined(FM_KEY_ATOMIC)
+  return a < b;
+#elif defined(FM_KEY_MEM)
+  return memcmp(a, b, FM_KEY_LEN) < 0;
+#elif defined(FM_KEY_STR)
+  return strncmp(a, b, FM_KEY_LEN) < 0;
+#else
+#  error Unable to determine how to compare the keys
+#endif
+}
+
+FM_FUNC_ATTR void P(init)(M* m) {
+  m->len = 0;
+  m->keys = NULL;
+  VAL(m->vals = NULL);
+  m->add_keys = NULL;
+  VAL(m->add_vals = NULL);
+}
+
+/**
+ * Internal. Frees the finalized arrays.
+ */
+FM_FUNC_ATTR void P(_free_arrays)(M* m) {
+  if (!m->keys)
+    return;
+  FM_FREE(m, m->keys, sizeof(K) * (m->len + 1));
+  VAL(FM_FREE(m, m->vals, sizeof(V) * (m->len + 1)));
+}
+
+FM_FUNC_ATTR void P(deinit)(M* m) {
+  P(_free_arrays)(m);
+  if (m->add_keys) {
+    arfree(m->add_keys);
+    VAL(arfree(m->add_vals));
+  }
+}
+
+/**
+ * Position of the first key that isn't less than `k`, 0 if there is none.
+ */
+FM_FUNC_ATTR size_t P(lower_bound)(M* m, K k) {
+  size_t i = 1;
+  while (i <= m->len) {
+    ds_prefetch(m->keys + PF * i);
+    i = 2 * i + P(less)(m->keys[i], k);
+  }
+  return i >> __builtin_ffsll(~i); // back up to the last left turn
+}
+
+/**
+ * Position of the first key greater than `k`, 0 if there is none.
+ */
+FM_FUNC_ATTR size_t P(upper_bound)(M* m, K k) {
+  size_t i = 1;
+  while (i <= m->len) {
+    ds_prefetch(m->keys + PF * i);
+    i = 2 * i + !P(less)(k, m->keys[i]);
+  }
+  return i >> __builtin_ffsll(~i);
+}
+
+/**
+ * Position of the smallest key, 0 if the map is empty.
+ */
+FM_FUNC_ATTR size_t P(first)(M* m) {
+  if (!m->len)
+    return 0;
+  size_t i = 1;
+  while (2 * i <= m->len)
+    i = 2 * i;
+  return i;
+}
+
+/**
+ * Position of the largest key, 0 if the map is empty.
+ */
+FM_FUNC_ATTR size_t P(last)(M* m) {
+  if (!m->len)
+    return 0;
+  size_t i = 1;
+  while (2 * i + 1 <= m->len)
+    i = 2 * i + 1;
+  return i;
+}
+
+/**
+ * Position of the key after the one at `i` in order, 0 after the last one.
+ */
+FM_FUNC_ATTR size_t P(succ)(M* m, size_t i) {
+  if (2 * i + 1 <= m->len) { // leftmost node of the right subtree
+    i = 2 * i + 1;
+    while (2 * i <= m->len)
+      i = 2 * i;
+    return i;
+  }
+  while (i & 1) // climb while coming from a right child
+    i >>= 1;
+  return i >> 1;
+}
+
+/**
+ * Position of the key before the one at `i` in order, 0 before the first one.
+ */
+FM_FUNC_ATTR size_t P(pred)(M* m, size_t i) {
+  if (2 * i <= m->len) { // rightmost node of the left subtree
+    i = 2 * i;
+    while (2 * i + 1 <= m->len)
+      i = 2 * i + 1;
+    return i;
+  }
+  while (i && !(i & 1)) // climb while coming from a left child
+    i >>= 1;
+  return i >> 1;
+}
+
+/**
+ * Cursor over the pairs in key order. Start with `*it` at a position (first,
+ * lower_bound, ...), each call points `k` and `v` at the pair there, moves
+ * `*it` to the next one and returns false once past the last one.
+ */
+FM_FUNC_ATTR bool P(next)(M* m, size_t* it, K** k VAL(, V** v)) {
+  if (!*it)
+    return false;
+  *k = &m->keys[*it];
+  VAL(*v = &m->vals[*it]);
+  *it = P(succ)(m, *it);
+  return true;
+}
+
+/**
+ * Whether the key is present.
+ */
+FM_FUNC_ATTR bool P(contains)(M* m, K k) {
+  size_t i = P(lower_bound)(m, k);
+  return i && !P(less)(k, m->keys[i]);
+}
+
+#ifndef FM_SET
+/**
+ * Finds the value under a key and returns a pointer to it, NULL if the key is
+ * not present.
+ */
+FM_FUNC_ATTR V* P(lookup)(M* m, K k) {
+  size_t i = P(lower_bound)(m, k);
+  return i && !P(less)(k, m->keys[i]) ? &m->vals[i] : NULL;
+}
+#endif
+
+/**
+ * Adds a pair. It shows up in the map after the next finalize.
+ */
+FM_FUNC_ATTR void P(add)(M* m, K k VAL(, V v)) {
+  if (!m->add_keys) {
+    arinit(m->add_keys);
+    VAL(arinit(m->add_vals));
+  }
+  memcpy(arpushm(m->add_keys, 1), KEY_PTR(k), sizeof(K));
+  VAL(arpush(m->add_vals, v));
+}
+
+struct P(_pair) {
+  K k;
+  VAL(V v;)
+  size_t seq; // order of adding, decides between duplicate keys
+};
+
+/**
+ * Internal. qsort order of pairs, by key and then by the order of adding.
+ */
+FM_FUNC_ATTR int P(_cmp)(const void* a, const void* b) {
+  struct P(_pair)* x = (struct P(_pair)*)a; // less takes non-const keys
+  struct P(_pair)* y = (struct P(_pair)*)b;
+  if (P(less)(x->k, y->k))
+    return -1;
+  if (P(less)(y->k, x->k))
+    return 1;
+  return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+/**
+ * Sorts the pairs added since the last finalize into the map and lays it out
+ * again, O(n log n) in the size of the whole map. Of duplicate keys the one
+ * added first is kept. Positions from before are invalid afterwards.
+ */
+FM_FUNC_ATTR void P(finalize)(M* m) {
+  if (!m->add_keys)
+    return;
+  size_t added = arlen(m->add_keys);
+  size_t n = m->len + added;
+  struct P(_pair)* ps = malloc(sizeof(*ps) * ds_max(n, (size_t)1));
+  size_t j = 0;
+  for (size_t i = P(first)(m); i; i = P(succ)(m, i), j++) {
+    memcpy(&ps[j].k, &m->keys[i], sizeof(K));
+    VAL(ps[j].v = m->vals[i]);
+    ps[j].seq = j;
+  }
+  for (size_t i = 0; i < added; i++, j++) {
+    memcpy(&ps[j].k, &m->add_keys[i], sizeof(K));
+    VAL(ps[j].v = m->add_vals[i]);
+    ps[j].seq = j;
+  }
+  arfree(m->add_keys);
+  VAL(arfree(m->add_vals));
+  m->add_keys = NULL;
+  VAL(m->add_vals = NULL);
+
+  qsort(ps, n, sizeof(*ps), P(_cmp));
+  size_t u = 0; // unique keys
+  for (size_t i = 0; i < n; i++)
+    if (!u || P(less)(ps[u - 1].k, ps[i].k))
+      ps[u++] = ps[i];
+
+  P(_free_arrays)(m);
+  m->len = u;
+  m->keys = FM_ALLOC(m, sizeof(K) * (u + 1));
+  VAL(m->vals = FM_ALLOC(m, sizeof(V) * (u + 1)));
+  j = 0;
+  for (size_t i = P(first)(m); i; i = P(succ)(m, i), j++) { // in-order fill
+    memcpy(&m->keys[i], &ps[j].k, sizeof(K));
+    VAL(m->vals[i] = ps[j].v);
+  }
+  free(ps);
+}
+
+/**
+ * Inits `m` with `n` pairs, `vals` is left out for sets.
+ */
+FM_FUNC_ATTR void P(build)(M* m, size_t n, K* keys VAL(, V* vals)) {
+  P(init)(m);
+  for (size_t i = 0; i < n; i++)
+    P(add)(m, keys[i] VAL(, vals[i]));
+  P(finalize)(m);
+}
+
+#undef P
+#undef M
+#undef K
+#undef V
+#undef VAL
+#undef KEY_PTR
+#undef PF
+#undef FM_SET
+
+#undef FM_PREFIX
+#undef FM_KEY
+#undef FM_VAL
+#undef FM_KEY_ATOMIC
+#undef FM_KEY_MEM
+#undef FM_KEY_STR
+#undef FM_KEY_LESS
+#undef FM_KEY_LEN
+#undef FM_ALLOC
+#undef FM_FREE
+#undef FM_MAP_EXTRA_VARS
+#undef FM_FUNC_ATTR
@@ -3,6 +3,8 @@
 
 #include "common.h"
 
+#include <string.h>
+
 // taken from https://www.ucw.cz/libucw/
 static uint ds_hash_u32(uint x) { return 0x01008041 * x; }
 static uint ds_hash_u64(u64 x) {
@@ -13,8 +15,19 @@ static uint ds_hash_pointer(void* x) {
                            : ds_hash_u64((u64)(uintptr_t)x));
 }
 
+// murmur3 fmix32 finalizer. Spreads the entropy of all input bits over the low
+// bits, which are the ones used to index a power of two sized table.
+static uint ds_hash_mix(uint h) {
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return h;
+}
+
 // http://www.cse.yorku.ca/~oz/hash.html - djb2
-static uint ds_hash_str(char* str) {
+static uint ds_hash_str(const char* str) {
   uint hash = 5381;
   int c;
 
@@ -25,7 +38,7 @@ static uint ds_hash_str(char* str) {
 }
 
 // http://www.cse.yorku.ca/~oz/hash.html - djb2 modified
-static uint ds_hash_mem(size_t len, char* str) {
+static uint ds_hash_mem(size_t len, const char* str) {
   uint hash = 5381;
 
   for (size_t i = 0; i < len; i++)
@@ -34,4 +47,74 @@ static uint ds_hash_mem(size_t len, char* str) {
   return hash;
 }
 
+// wyhash (https://github.com/wangyi-fudan/wyhash, public domain).
+// Reads the key 8 or 16 bytes at a time and mixes with 64x64->128 bit
+// multiplies. Keys longer than 48 bytes go through three independent lanes,
+// which keeps the multipliers busy better than a 128 bit SIMD lane would.
+#define DS_WY0 0x2d358dccaa6c78a5ull
+#define DS_WY1 0x8bb84b93962eacc9ull
+#define DS_WY2 0x4b33a62ed433d4a3ull
+#define DS_WY3 0x4d5a2da51de1aa47ull
+
+static u64 ds_wymix(u64 a, u64 b) {
+  __uint128_t r = (__uint128_t)a * b;
+  return (u64)r ^ (u64)(r >> 64);
+}
+
+static u64 ds_wyr8(const byte* p) {
+  u64 v;
+  memcpy(&v, p, 8);
+  return v;
+}
+
+static u64 ds_wyr4(const byte* p) {
+  u32 v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+static u64 ds_hash_wy(const void* key, size_t len, u64 seed) {
+  const byte* p = key;
+  u64 a, b;
+  seed ^= ds_wymix(seed ^ DS_WY0, DS_WY1);
+  if (ds_likely(len <= 16)) {
+    if (ds_likely(len >= 4)) {
+      size_t o = (len >> 3) << 2; // 0 or 4
+      a = (ds_wyr4(p) << 32) | ds_wyr4(p + o);
+      b = (ds_wyr4(p + len - 4) << 32) | ds_wyr4(p + len - 4 - o);
+    } else if (ds_likely(len > 0)) {
+      a = ((u64)p[0] << 16) | ((u64)p[len >> 1] << 8) | p[len - 1];
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    size_t i = len;
+    if (ds_unlikely(i > 48)) {
+      u64 s1 = seed, s2 = seed;
+      do {
+        seed = ds_wymix(ds_wyr8(p) ^ DS_WY1, ds_wyr8(p + 8) ^ seed);
+        s1 = ds_wymix(ds_wyr8(p + 16) ^ DS_WY2, ds_wyr8(p + 24) ^ s1);
+        s2 = ds_wymix(ds_wyr8(p + 32) ^ DS_WY3, ds_wyr8(p + 40) ^ s2);
+        p += 48;
+        i -= 48;
+      } while (ds_likely(i > 48));
+      seed ^= s1 ^ s2;
+    }
+    while (ds_unlikely(i > 16)) {
+      seed = ds_wymix(ds_wyr8(p) ^ DS_WY1, ds_wyr8(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+    a = ds_wyr8(p + i - 16);
+    b = ds_wyr8(p + i - 8);
+  }
+  a ^= DS_WY1;
+  b ^= seed;
+  __uint128_t r = (__uint128_t)a * b;
+  a = (u64)r;
+  b = (u64)(r >> 64);
+  return ds_wymix(a ^ DS_WY0 ^ len, b ^ DS_WY1);
+}
+
 #endif
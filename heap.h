@@ -0,0 +1,293 @@
+#include "ar.h"
+#include "common.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * # d-ary heap generator header
+ *
+ * ## Usage
+ *
+ * Priority queue of HEAP_TYPE elements, the smallest by HEAP_LESS on top.
+ *
+ * ```c
+ * struct timer {
+ *   u64 deadline;
+ *   u32 id;
+ * };
+ *
+ * #define HEAP_PREFIX timers
+ * #define HEAP_TYPE struct timer
+ * #define HEAP_LESS(a, b) ((a).deadline < (b).deadline)
+ * #define HEAP_SET_INDEX(e, i) (pos[(e).id] = (i))
+ * #include "heap.h"
+ *
+ * struct timers_heap h;
+ * timers_init(&h);
+ * timers_push(&h, (struct timer){now + 10, id});
+ * while (h.len && timers_peek(&h).deadline <= now)
+ *   fire(timers_pop(&h));
+ * timers_decrease(&h, pos[id], (struct timer){now + 1, id});
+ * ```
+ *
+ * ## Internal workings
+ *
+ * Every node has HEAP_ARITY children, `i` has them at `d*i + 1` to `d*i + d`,
+ * so the heap is log_d(n) levels deep instead of log_2(n) and a sift-down
+ * compares all the children of a node, which sit next to each other in
+ * memory. The elements live in an ar.h array that starts with a few spare
+ * slots, the root is put at the one that lines up every group of siblings with
+ * a cache line (when the group size allows it), so finding the smallest child
+ * touches a single line. When the array moves while growing, the elements are
+ * shifted to line up again.
+ *
+ * Sifting moves the elements into a hole instead of swapping them.
+ *
+ * ## Required macros
+ *
+ * HEAP_PREFIX - value of this is used as the prefix for all functions
+ * HEAP_TYPE - the element type
+ *
+ * ### Switches
+ *
+ * HEAP_LESS(a, b) - the order of elements, `(a) < (b)` by default
+ * HEAP_ARITY - children per node (default 4). 4 or 8 keep a group of 8 or 16
+ *              byte elements within a cache line, 2 is a binary heap.
+ * HEAP_SET_INDEX(e, i) - Called with every element `e` (an lvalue) that gets
+ *              placed at heap index `i`. Storing `i` somewhere, in the element
+ *              or in a side array, gives a handle for `decrease`, `update`
+ *              and `remove`.
+ * HEAP_FUNC_ATTR - Attributes of all functions, e.g. `static inline`
+ *
+ * ### Functions
+ *
+ * Function | Description
+ * ---------|----
+ * init     | Init an empty heap
+ * deinit   | Free memory used by a heap
+ * push     | Add an element
+ * peek     | The smallest element, the heap must not be empty
+ * pop      | Remove and return the smallest element, not on an empty heap
+ * heapify  | Add an array of elements at once in O(len + n)
+ * decrease | Replace the element at an index with a smaller one
+ * update   | Restore the order after the element at an index changed
+ * remove   | Remove and return the element at an index
+ */
+
+#ifndef HEAP_TYPE
+#  error You have to define HEAP_TYPE
+#endif
+
+#ifndef HEAP_LESS
+#  define HEAP_LESS(a, b) ((a) < (b))
+#endif
+
+#ifndef HEAP_ARITY
+// Children per node
+#  define HEAP_ARITY 4
+#endif
+
+#if HEAP_ARITY < 2
+#  error HEAP_ARITY has to be at least 2
+#endif
+
+#ifndef HEAP_FUNC_ATTR
+#  define HEAP_FUNC_ATTR
+#endif
+
+#define P(x) ds_glue_expanded_(HEAP_PREFIX, x)
+
+// shortcuts
+#define E HEAP_TYPE
+#define H struct P(heap)
+#define D HEAP_ARITY
+
+#ifdef HEAP_SET_INDEX
+#  define PLACE(h, i, x) ((h)->e[i] = (x), HEAP_SET_INDEX((h)->e[i], i))
+#else
+#  define PLACE(h, i, x) ((h)->e[i] = (x))
+#endif
+
+// Alignment of the groups of siblings: a cache line when groups fill whole
+// lines, the group when it divides a line and nothing otherwise.
+#define GROUP (D * sizeof(E))
+#define ALIGN                                                                  \
+  (GROUP % 64 == 0 ? 64 : 64 % GROUP == 0 ? GROUP : sizeof(E))
+#define SLACK (ALIGN / sizeof(E)) // spare slots in front of the root
+
+struct P(heap) {
+  size_t len; // number of elements
+  E* e;       // the root, points into `a`
+  E* a;       // ar.h array of SLACK + len slots
+  size_t pad; // slots in front of the root
+};
+
+/**
+ * Internal. Slots to leave in front of the root of array `a` so that the
+ * children of the root (and so every group of siblings) start at a multiple of
+ * ALIGN. 0 when that isn't possible.
+ */
+HEAP_FUNC_ATTR size_t P(_pad)(E* a) {
+  size_t r = (uintptr_t)(a + 1) % ALIGN;
+  return r % sizeof(E) ? 0 : (ALIGN - r) % ALIGN / sizeof(E);
+}
+
+/**
+ * Internal. Adds `n` slots to the array, lining the elements up again if it
+ * moved.
+ */
+HEAP_FUNC_ATTR void P(_grow)(H* h, size_t n) {
+  E* old = h->a;
+  arpushm(h->a, n);
+  if (h->a == old)
+    return;
+  size_t pad = P(_pad)(h->a);
+  if (pad != h->pad)
+    memmove(h->a + pad, h->a + h->pad, sizeof(E) * h->len);
+  h->pad = pad;
+  h->e = h->a + pad;
+}
+
+HEAP_FUNC_ATTR void P(init)(H* h) {
+  h->len = 0;
+  arinit(h->a);
+  arpushm(h->a, SLACK);
+  h->pad = P(_pad)(h->a);
+  h->e = h->a + h->pad;
+}
+
+HEAP_FUNC_ATTR void P(deinit)(H* h) { arfree(h->a); }
+
+/**
+ * Internal. Moves the hole at `i` up until `x` fits in it.
+ */
+HEAP_FUNC_ATTR void P(_up)(H* h, size_t i, E x) {
+  while (i > 0) {
+    size_t p = (i - 1) / D;
+    if (!HEAP_LESS(x, h->e[p]))
+      break;
+    PLACE(h, i, h->e[p]);
+    i = p;
+  }
+  PLACE(h, i, x);
+}
+
+/**
+ * Internal. Moves the hole at `i` down until `x` fits in it.
+ */
+HEAP_FUNC_ATTR void P(_down)(H* h, size_t i, E x) {
+  size_t n = h->len;
+  for (;;) {
+    size_t c = D * i + 1;
+    if (c >= n)
+      break;
+    // smallest child, kept in a register instead of reloaded through `m`
+    size_t m = c;
+    E y = h->e[c];
+    size_t e = ds_min(c + D, n); // full groups are unrolled by the compiler
+    for (size_t j = c + 1; j < e; j++) {
+      if (HEAP_LESS(h->e[j], y)) {
+        y = h->e[j];
+        m = j;
+      }
+    }
+    if (!HEAP_LESS(y, x))
+      break;
+    PLACE(h, i, y);
+    i = m;
+  }
+  PLACE(h, i, x);
+}
+
+/**
+ * Adds an element.
+ */
+HEAP_FUNC_ATTR void P(push)(H* h, E x) {
+  P(_grow)(h, 1);
+  P(_up)(h, h->len++, x);
+}
+
+/**
+ * The smallest element. The heap must not be empty.
+ */
+HEAP_FUNC_ATTR E P(peek)(H* h) {
+  assert(h->len);
+  return h->e[0];
+}
+
+/**
+ * Removes and returns the element at index `i`, e.g. from HEAP_SET_INDEX.
+ */
+HEAP_FUNC_ATTR E P(remove)(H* h, size_t i) {
+  assert(i < h->len);
+  E r = h->e[i];
+  E x = h->e[--h->len];
+  ds_unused E _ = arpop(h->a);
+  if (i < h->len) { // the last element fills the hole
+    if (i > 0 && HEAP_LESS(x, h->e[(i - 1) / D]))
+      P(_up)(h, i, x);
+    else
+      P(_down)(h, i, x);
+  }
+  return r;
+}
+
+/**
+ * Removes and returns the smallest element. The heap must not be empty.
+ */
+HEAP_FUNC_ATTR E P(pop)(H* h) { return P(remove)(h, 0); }
+
+/**
+ * Replaces the element at index `i` by `x`, which must not be greater.
+ */
+HEAP_FUNC_ATTR void P(decrease)(H* h, size_t i, E x) {
+  assert(i < h->len && !HEAP_LESS(h->e[i], x));
+  P(_up)(h, i, x);
+}
+
+/**
+ * Moves the element at index `i` to its place after it was changed in either
+ * direction.
+ */
+HEAP_FUNC_ATTR void P(update)(H* h, size_t i) {
+  assert(i < h->len);
+  E x = h->e[i];
+  if (i > 0 && HEAP_LESS(x, h->e[(i - 1) / D]))
+    P(_up)(h, i, x);
+  else
+    P(_down)(h, i, x);
+}
+
+/**
+ * Adds `n` elements at once. Sifts down every parent bottom-up, which is
+ * O(len + n) instead of O(n log(len + n)) for `n` pushes.
+ */
+HEAP_FUNC_ATTR void P(heapify)(H* h, E* xs, size_t n) {
+  P(_grow)(h, n);
+  memcpy(h->e + h->len, xs, sizeof(E) * n);
+#ifdef HEAP_SET_INDEX
+  for (size_t i = h->len; i < h->len + n; i++)
+    HEAP_SET_INDEX(h->e[i], i);
+#endif
+  h->len += n;
+  for (size_t i = h->len > 1 ? (h->len - 2) / D + 1 : 0; i-- > 0;)
+    P(_down)(h, i, h->e[i]);
+}
+
+#undef P
+#undef E
+#undef H
+#undef D
+#undef PLACE
+#undef GROUP
+#undef ALIGN
+#undef SLACK
+
+#undef HEAP_PREFIX
+#undef HEAP_TYPE
+#undef HEAP_LESS
+#undef HEAP_ARITY
+#undef HEAP_SET_INDEX
+#undef HEAP_FUNC_ATTR
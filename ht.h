@@ -1,7 +1,27 @@
+#include "bigalloc.h"
 #include "common.h"
 #include "hash.h"
 
 #include <assert.h>
+#include <string.h>
+
+#ifndef ht_foreach
+// Loops over table `t` made with HT_PREFIX `prefix`, `k` and `v` point to the
+// key and value of each pair.
+#  define ht_foreach(prefix, t, k, v)                                          \
+    for (size_t _it = 0, _k = 1; _k; _k = 0)                                   \
+      for (ds_glue_expanded_(prefix, _k)* k; _k; _k = 0)                       \
+        for (ds_glue_expanded_(prefix, _v)* v;                                 \
+             ds_glue_expanded_(prefix, next)(t, &_it, &k, &v);)
+#endif
+
+#ifndef ht_foreach_key
+// ht_foreach for sets (tables without HT_VAL), `k` points to each key.
+#  define ht_foreach_key(prefix, t, k)                                         \
+    for (size_t _it = 0, _k = 1; _k; _k = 0)                                   \
+      for (ds_glue_expanded_(prefix, _k)* k;                                   \
+           ds_glue_expanded_(prefix, next)(t, &_it, &k);)
+#endif
 
 /*
  * # Hashtable generator header
@@ -15,14 +35,24 @@
  *
  * Hash table with open adressing and linear probing. Keys and values are kept
  * in two separate arrays to keep the linear probing most likely away from RAM.
- * Value lookup will probably be a cache-miss but only one per lookup.
+ * Value lookup will probably be a cache-miss but only one per lookup, unless
+ * HT_LAYOUT_INLINE puts them together.
+ *
+ * Capacity is always a power of two so slots are picked by masking the hash.
+ * The hash is passed through `ds_hash_mix` first so that weak hash functions
+ * don't cluster in the low bits.
  *
  * ## Required macros
  *
  * HT_PREFIX - value of this is used as the prefix for all functions
  *
  * HT_KEY - the key struct / type
- * HT_VAL - the value struct / type
+ * HT_VAL - the value struct / type. Leave it out to get a set: there is no
+ *          value array at all, so a set takes about half the memory and
+ *          rehashing bandwidth of a map with small values. Sets have `add`,
+ *          `contains` and `remove` taking only the key instead of the
+ *          value functions, `add_batch` instead of `insert_batch`, and
+ *          `next`, `build` and `ht_foreach_key` without values.
  *
  * ### Macros that define how to compare and move keys
  *
@@ -30,14 +60,104 @@
  * --------------|---------|---------|-------
  * HT_KEY_ATOMIC | `==`    | `=`     | `int`, `char`, `long`, ...
  * HT_KEY_MEM    | memcmp  | memcpy  | HT_KEY_LEN required. (key is char*)
- * HT_KEY_STR    | strncmp | strncpy | HT_KEY_LEN required. (key is char[N])
- * HT_KEY_STRPTR | strcmp  | strcpy  | string outside the key (var len)
+ * HT_KEY_STR    | strncmp | memcpy  | HT_KEY_LEN required. (key is char[N])
+ * HT_KEY_STRPTR | strcmp  | `=`     | string outside the key (var len)
  * HT_KEY_CUSTOM | HT_EQ   | HT_CPY  | HT_KEY_DECL required
  *
+ * HT_KEY_STR and HT_KEY_STRPTR don't need HT_KEY (it's `P(str)`, a char array,
+ * and `const char*`) and imply HT_CACHE_HASH.
+ *
  * ### Switches
  *
  * HT_BYVAL - Return values in the hash table by value instead of by pointer
  * HT_WANT_PRINT - Create a debug print function
+ * HT_WANT_STATS - Count searches, probes, misses, rehashes, time spent
+ *                rehashing and graves in the `counters` field and create
+ *                `stats`, which also measures probe lengths and clustering of
+ *                the table as it is. A mean distance far above the expected
+ *                one points at a bad hash function.
+ * HT_WANT_SNAPSHOT - Create `save` and `load_mmap`. `save` writes the
+ *                containers to a file, `load_mmap` maps such a file read-only
+ *                and serves lookups right from it. Keys and values have to be
+ *                plain data, so HT_KEY_MEM and HT_KEY_STRPTR are out. The file
+ *                is only readable by a build with the same layout, hash and
+ *                byte order. A loaded table can't be modified.
+ * HT_ALLOC(t, size), HT_FREE(t, ptr, size) - Allocator of the key/value
+ *                containers, bigalloc.h by default (malloc for small tables,
+ *                huge page mappings for big ones). `t` is the table, so
+ *                an allocator can live in HT_TABLE_EXTRA_VARS, e.g.
+ *                `ds_arena_palloc((t)->arena, size)` from arena.h, or use
+ *                `xmalloc(size)` from x.h to trap on OOM. Set the extra
+ *                vars before `init`, which already allocates. `alloc` zeroes
+ *                them, `alloc_with` takes them from a template. Both get the
+ *                table itself from malloc.
+ * HT_LAYOUT_INLINE - Store each key and its value together in one slot struct
+ *                instead of in two arrays. A successful lookup then touches a
+ *                single cache line instead of two, which pays off on tables
+ *                bigger than the cache when values are small. Probing reads
+ *                the values along, so long probes and misses get slower, and
+ *                the slots get padded to the alignment of the bigger type.
+ *                Works with all the other modes, a set ignores it.
+ * HT_SMALL - Keep up to HT_SMALL (1 to 32) elements in arrays inside the
+ *                table struct. `init` allocates nothing, the elements are
+ *                found by a linear scan (vectorized for HT_KEY_ATOMIC, without
+ *                hashing) and the table moves into allocated containers once
+ *                it grows past HT_SMALL. `shrink_to_fit` moves it back. Meant
+ *                for lots of tiny tables. Probes of the inline elements are
+ *                not counted by HT_WANT_STATS. Can't be combined with
+ *                HT_WANT_SNAPSHOT.
+ * HT_SIZE - Type of `len`, `cap` and `graves`, size_t by default. `uint32_t`
+ *                shrinks the table struct from 40 to 32 bytes for tables
+ *                below 2^31 slots.
+ * HT_MIN_DENSITY - Shrink the table in `remove` once fewer than this share
+ *                of the slots is used, e.g. 0.125. Off by default, tables only
+ *                shrink in `shrink_to_fit` then.
+ * HT_FAST_HASH - Hash HT_KEY_MEM, HT_KEY_STR and HT_KEY_STRPTR keys with
+ *                `ds_hash_wy` instead of djb2, seeded with HT_HASH_SEED
+ *                (default 0)
+ *
+ * #### HT_CACHE_HASH
+ * Store the full hash of every key in an array next to the keys. Probing
+ * compares the stored hash first, so `eq` (and any memory the key points to)
+ * is only touched when the hashes match, and rehashing never recomputes a
+ * hash. Empty and grave slots are marked in the hash array, so HT_KEY_EMPTY
+ * and HT_KEY_GRAVE are not needed. Can't be combined with HT_CTRL,
+ * HT_ROBIN_HOOD or HT_INCREMENTAL.
+ *
+ * #### HT_CTRL
+ * Keep a one byte control array next to the keys. Each byte holds either
+ * 7 bits of the key's hash or an empty/grave marker. Probing compares 16
+ * control bytes at once (SSE2 when available) and calls `eq` only on slots
+ * whose hash fragment matches, so a lookup usually does a single real key
+ * compare. HT_KEY_EMPTY and HT_KEY_GRAVE are not needed in this mode.
+ *
+ * #### HT_ROBIN_HOOD
+ * Robin Hood insertion with backward-shift deletion. Keys stay ordered by
+ * their home slot, so a lookup for a missing key stops as soon as it meets a
+ * key closer to its home than the probe is, and removal shifts the following
+ * keys back instead of leaving a grave. The table never has graves, so
+ * HT_MAX_DENSITY can be set higher. Like HT_CACHE_HASH every slot keeps the
+ * key's hash (4 bytes), which gives the distances from home the probes compare
+ * without rehashing keys and is compared before `eq`. Empty slots are marked
+ * in it, so HT_KEY_EMPTY and HT_KEY_GRAVE are not needed. Can't be combined
+ * with HT_CTRL.
+ *
+ * #### HT_INCREMENTAL
+ * Spread growing and grave clearing over subsequent operations instead of
+ * rehashing the whole table inside one insert. When a rehash is due, the old
+ * containers are kept aside and every insert/update/remove moves up to
+ * HT_MIGRATE_STEP (default 64) old slots into the new ones. Lookups check both
+ * until the migration is done. `rehash` still works synchronously.
+ * Can't be combined with HT_CTRL or HT_ROBIN_HOOD.
+ *
+ * #### HT_COMPACT
+ * Keep keys, values and their hashes in dense arrays in insertion order and
+ * probe a separate index of entry numbers instead. The index is made of 8, 16,
+ * 32 or 64 bit slots depending on the capacity, so it is much smaller than
+ * the keys, and iterating with `next` streams only the entries. Removing
+ * leaves a hole in the entries that is closed by the next rehash. Empty and
+ * grave slots are marked in the index, so HT_KEY_EMPTY and HT_KEY_GRAVE are
+ * not needed. Can't be combined with HT_CTRL, HT_ROBIN_HOOD or HT_INCREMENTAL.
  *
  * #### HT_MULTIKEY
  * Allows you to alter number of arguments that all functions take as key.
@@ -54,32 +174,91 @@
  * init     | Init a table
  * deinit   | Free memory used by a table
  * alloc    | Alloc + init a table
+ * alloc_with | alloc that sets HT_TABLE_EXTRA_VARS before the first HT_ALLOC
  * free     | Free memory used by a table and the table itself
  *
  * lookup   | Try to find a value under a key.
  * insert   | Try to insert a new key-value pair.
  * update   | Update value under a key. Create key if needed.
+ * entry    | Pointer to the value under a key, create key if needed.
+ * get_or_insert | entry that initializes a created value
  * delete   | Delete a key-value pair if it exists.
+ * add      | Add a key to a set.
+ * contains | Whether a key is present.
+ * next     | Cursor over all pairs, see also `ht_foreach`.
+ *
+ * reserve        | Make room for a number of elements up front
+ * shrink_to_fit  | Shrink to the smallest capacity that fits the elements
+ * build          | Init a table from arrays of keys and values
+ * stats          | Counters and probe statistics (HT_WANT_STATS)
+ *
+ * lookup_batch   | lookup for an array of keys, overlapping cache misses
+ * contains_batch | contains for an array of keys
+ * insert_batch   | insert for arrays of keys and values
+ * add_batch      | add for an array of keys (sets)
  */
 
 #if defined(HT_MULTIKEY) && defined(HT_KEY)
 #  error You cant define both HT_MULTIKEY and HT_KEY
 #endif
 
-#if !defined(HT_MULTIKEY) && !defined(HT_KEY)
+#if defined(HT_KEY_STR) || defined(HT_KEY_STRPTR)
+#  define HT_CACHE_HASH
+#endif
+
+#if !defined(HT_MULTIKEY) && !defined(HT_KEY) && !defined(HT_KEY_STR) &&      \
+    !defined(HT_KEY_STRPTR)
 #  error You have to define either HT_KEY or HT_MULTIKEY
 #endif
 
 #ifndef HT_VAL
-#  error You have to define HT_VAL
+#  define HT_SET
+#  undef HT_LAYOUT_INLINE // nothing to put next to the keys
+#endif
+
+#if defined(HT_CTRL) && defined(HT_ROBIN_HOOD)
+#  error You cant combine HT_CTRL and HT_ROBIN_HOOD
+#endif
+
+#if defined(HT_INCREMENTAL) && (defined(HT_CTRL) || defined(HT_ROBIN_HOOD))
+#  error HT_INCREMENTAL works only with the default linear probing
+#endif
+
+#if defined(HT_CACHE_HASH) &&                                                  \
+    (defined(HT_CTRL) || defined(HT_ROBIN_HOOD) || defined(HT_INCREMENTAL))
+#  error HT_CACHE_HASH works only with the default linear probing
+#endif
+
+#if defined(HT_COMPACT) &&                                                     \
+    (defined(HT_CTRL) || defined(HT_ROBIN_HOOD) || defined(HT_INCREMENTAL))
+#  error HT_COMPACT works only with the default linear probing
+#endif
+
+// Internal. The containers have a `hashes` array.
+#if defined(HT_CACHE_HASH) || defined(HT_COMPACT) || defined(HT_ROBIN_HOOD)
+#  define HASHES
+#endif
+
+#if defined(HT_WANT_SNAPSHOT) && (defined(HT_KEY_MEM) || defined(HT_KEY_STRPTR))
+#  error HT_WANT_SNAPSHOT needs keys stored inside the table
+#endif
+
+#if defined(HT_SMALL) && defined(HT_WANT_SNAPSHOT)
+#  error You cant combine HT_SMALL and HT_WANT_SNAPSHOT
 #endif
 
-#ifndef HT_KEY_EMPTY
-#  error You have to define special grave key value
+#if defined(HT_SMALL) && (HT_SMALL < 1 || HT_SMALL > 32)
+#  error HT_SMALL has to be between 1 and 32
 #endif
 
-#ifndef HT_KEY_GRAVE
-#  error You have to define special grave key value
+#if !defined(HT_CTRL) && !defined(HASHES)
+#  ifndef HT_KEY_EMPTY
+#    error You have to define special empty key value
+#  endif
+
+#  ifndef HT_KEY_GRAVE
+#    error You have to define special grave key value
+#  endif
 #endif
 
 #ifndef HT_MAX_DENSITY
@@ -92,10 +271,52 @@
 #  define HT_MAX_GRAVE 0.25
 #endif
 
+#ifndef HT_MIN_DENSITY
+// Elements/capacity ratio below which remove shrinks the table. Off by default,
+// e.g. 0.125 saves memory after mass removals but makes tables that empty out
+// and fill again regularly rehash twice per cycle.
+#  define HT_MIN_DENSITY 0
+#endif
+
+#ifndef HT_MIGRATE_STEP
+// Old slots moved by each modifying operation during incremental rehash
+#  define HT_MIGRATE_STEP 64
+#endif
+
+#ifndef HT_BATCH
+// Keys hashed and prefetched ahead by the *_batch functions
+#  define HT_BATCH 16
+#endif
+
+#ifndef HT_BUILD_PART
+// Slots covered by one partition of build, power of two
+#  define HT_BUILD_PART 4096
+#endif
+
+#ifndef HT_HASH_SEED
+// Seed of HT_FAST_HASH
+#  define HT_HASH_SEED 0
+#endif
+
+#ifndef HT_ALLOC
+// Allocates memory for the containers of table `t`
+#  define HT_ALLOC(t, size) ds_big_alloc(size)
+#endif
+
+#ifndef HT_FREE
+// Frees containers of table `t` allocated by HT_ALLOC
+#  define HT_FREE(t, ptr, size) ds_big_free(ptr, size)
+#endif
+
 #ifndef HT_FUNC_ATTR
 #  define HT_FUNC_ATTR
 #endif
 
+#ifndef HT_SIZE
+// Type of len, cap and graves
+#  define HT_SIZE size_t
+#endif
+
 #define P(x) ds_glue_expanded_(HT_PREFIX, x)
 
 #ifdef HT_MULTIKEY
@@ -105,6 +326,15 @@ struct P(key) {
 #  define KARG HT_MULTIKEY(, ds_comma)
 #  define KARGPASS HT_MULTIKEY_NAMES(, )
 #  define HT_KEY P(key)
+#elif defined(HT_KEY_STR) && !defined(HT_KEY)
+typedef char P(str)[HT_KEY_LEN];
+#  define HT_KEY P(str)
+#  define KARG K k
+#  define KARGPASS k
+#elif defined(HT_KEY_STRPTR) && !defined(HT_KEY)
+#  define HT_KEY const char*
+#  define KARG K k
+#  define KARGPASS k
 #else
 #  define KARG K k
 #  define KARGPASS k
@@ -113,21 +343,185 @@ struct P(key) {
 
 // shortcuts
 #define K HT_KEY
-#define V HT_VAL
+#ifdef HT_SET
+#  define VAL(...) // sets have no values, drops the value plumbing
+#  define VAL_SIZE 0
+#else
+#  define V HT_VAL
+#  define VAL(...) __VA_ARGS__
+#  define VAL_SIZE sizeof(V)
+#endif
+
+typedef K P(_k); // for ht_foreach
+VAL(typedef V P(_v);)
+
+#ifdef HT_LAYOUT_INLINE
+struct P(slot) {
+  K k;
+  V v;
+};
+#  define KS struct P(slot) // element of the key containers
+#  define KEY_AT(ks, i) (ks)[i].k
+#  define VAL_AT(ks, vs, i) (ks)[i].v
+#  define VARR(...) // there are no value containers
+#else
+#  define KS K
+#  define KEY_AT(ks, i) (ks)[i]
+#  define VAL_AT(ks, vs, i) (vs)[i]
+#  define VARR(...) VAL(__VA_ARGS__)
+#endif
+// key and value in slot (entry with HT_COMPACT) `i` of the current containers
+#define SLOT_KEY(t, i) KEY_AT((t)->keys, i)
+#define SLOT_VAL(t, i) VAL_AT((t)->keys, (t)->vals, i)
 #define IS_GRAVE(x) P(eq)(HT_KEY_GRAVE, x)
 #define IS_EMPTY(x) P(eq)(HT_KEY_EMPTY, x)
 
 #define MAKE_GRAVE(x) x = HT_KEY_GRAVE
 #define MAKE_EMPTY(x) x = HT_KEY_EMPTY
 
+#ifdef HT_KEY_STR
+#  define KEY_MOVE(dst, src) memcpy(dst, src, HT_KEY_LEN)
+#else
+#  define KEY_MOVE(dst, src) dst = src
+#endif
+
+#ifdef HT_CTRL
+#  ifdef __SSE2__
+#    include <emmintrin.h>
+#  endif
+#  define GROUP 16 // slots checked at once, capacity is always a multiple
+#  define CTRL_EMPTY ((u8)0x80)
+#  define CTRL_GRAVE ((u8)0xfe)
+#  define CTRL_H1(h) ((h) >> 7)          // selects the starting group
+#  define CTRL_H2(h) ((u8)((h) & 0x7f)) // stored in the control byte
+#  define SLOT_EMPTY(t, i) ((t)->ctrl[i] == CTRL_EMPTY)
+#  define SLOT_GRAVE(t, i) ((t)->ctrl[i] == CTRL_GRAVE)
+#  define MIN_CAP GROUP
+#elif defined(HT_ROBIN_HOOD)
+#  define HASH_EMPTY 0 // stored hashes of keys are above both
+#  define HASH_GRAVE 1 // never stored
+#  define SLOT_EMPTY(t, i) ((t)->hashes[i] == HASH_EMPTY)
+#  define SLOT_GRAVE(t, i) false
+#  define MIN_CAP 8
+#elif defined(HT_COMPACT)
+#  define HASH_EMPTY 0 // never stored, hashes of keys are above both
+#  define HASH_GRAVE 1 // marks a removed entry
+#  define IX_EMPTY 0   // index slots hold the entry number + 2
+#  define IX_GRAVE 1
+#  define SLOT_EMPTY(t, i) (P(_ix_get)(t, i) == IX_EMPTY)
+#  define SLOT_GRAVE(t, i) (P(_ix_get)(t, i) == IX_GRAVE)
+#  define MIN_CAP 8
+#elif defined(HT_CACHE_HASH)
+#  define HASH_EMPTY 0 // stored hashes of keys are always above these two
+#  define HASH_GRAVE 1
+#  define SLOT_EMPTY(t, i) ((t)->hashes[i] == HASH_EMPTY)
+#  define SLOT_GRAVE(t, i) ((t)->hashes[i] == HASH_GRAVE)
+#  define MIN_CAP 8
+#else
+#  define SLOT_EMPTY(t, i) IS_EMPTY(SLOT_KEY(t, i))
+#  define SLOT_GRAVE(t, i) IS_GRAVE(SLOT_KEY(t, i))
+#  define MIN_CAP 8
+#endif
+
+#ifdef HT_COMPACT
+#  define ECAP(t) P(_ecap)((t)->cap) // size of the key/value containers
+#else
+#  define ECAP(t) ((t)->cap)
+#endif
+
+#ifdef HT_SMALL
+#  define SMALL(t) ((t)->cap == 0) // elements are in the inline slots
+#endif
+
+#ifdef HT_WANT_SNAPSHOT
+#  include <fcntl.h>
+#  include <stdio.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#  define SNAP_MAGIC 0x70616e7374687364ull // "dshtsnap"
+#endif
+
+#ifdef HT_WANT_STATS
+#  include <time.h>
+#  define STAT(x) x
+#  ifndef HT_STATS_HIST
+// Buckets of the probe length histogram of stats
+#    define HT_STATS_HIST 16
+#  endif
+
+struct P(counters) {
+  u64 lookups;   // key searches, insert, update and remove search too
+  u64 probes;    // slots (groups with HT_CTRL) looked at by the searches
+  u64 misses;    // searches that didn't find the key
+  u64 rehashes;  // including shrinking and incremental migrations
+  u64 rehash_ns; // time spent rehashing and migrating
+  u64 graves;    // graves made by remove
+};
+
+struct P(stats) {
+  struct P(counters) counters;
+  size_t len, cap, graves;
+  // keys by distance from their home slot (group with HT_CTRL), the last
+  // bucket counts all keys that are even further
+  size_t hist[HT_STATS_HIST];
+  size_t max_dist;
+  double mean_dist;
+  double expected_dist; // mean_dist of an ideal hash at this load, 0 for CTRL
+  size_t clusters;      // runs of used or grave slots
+  size_t max_cluster;
+  double mean_cluster;
+};
+
+HT_FUNC_ATTR u64 P(_ns)(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+#else
+#  define STAT(x)
+#endif
+
 #define T struct P(table)
 
 struct P(table) {
-  size_t len;    // number of elements in table
-  size_t cap;    // capacity of the key&value containers
-  size_t graves; // number of graves in the table
+  HT_SIZE len;    // number of elements in table
+  HT_SIZE cap;    // capacity of the key&value containers, 0 while small
+  HT_SIZE graves; // number of graves in the table
+#if !defined(HT_SET) && !defined(HT_LAYOUT_INLINE)
   V* vals;
-  K* keys;
+#endif
+  KS* keys; // keys and values with HT_LAYOUT_INLINE
+#ifdef HT_CTRL
+  u8* ctrl; // CTRL_EMPTY, CTRL_GRAVE or CTRL_H2 of the key
+#endif
+#ifdef HASHES
+  uint* hashes; // HASH_EMPTY, HASH_GRAVE or _hash of the key
+#endif
+#ifdef HT_COMPACT
+  // keys, vals and hashes are the entries, `cap` is the size of the index
+  void* index; // IX_EMPTY, IX_GRAVE or entry + 2, width from P(_ix_shift)
+  HT_SIZE used; // entries appended since the last rehash, including removed
+#endif
+#ifdef HT_INCREMENTAL
+#  if !defined(HT_SET) && !defined(HT_LAYOUT_INLINE)
+  V* ovals; // containers being migrated, NULL when not migrating
+#  endif
+  KS* okeys;
+  size_t ocap; // capacity of the old containers
+  size_t opos; // old slots below this one were already migrated
+#endif
+#ifdef HT_SMALL
+  K skeys[HT_SMALL]; // the first HT_SMALL elements, before any containers
+  VAL(V svals[HT_SMALL]);
+#endif
+#ifdef HT_WANT_STATS
+  struct P(counters) counters; // can be reset by the user
+#endif
+#ifdef HT_WANT_SNAPSHOT
+  void* map;      // mapping of a loaded snapshot, NULL for normal tables
+  size_t map_len;
+#endif
 #ifdef HT_TABLE_EXTRA_VARS
   HT_TABLE_EXTRA_VARS
 #endif
@@ -137,8 +531,22 @@ struct P(table) {
 HT_FUNC_ATTR uint P(hash)(K key) {
 #  ifdef HT_KEY_ATOMIC
   return ((sizeof(key) <= 4) ? ds_hash_u32(key) : ds_hash_u64(key));
+#  elif defined(HT_KEY_MEM) && defined(HT_FAST_HASH)
+  u64 h = ds_hash_wy(key, HT_KEY_LEN, HT_HASH_SEED);
+  return (uint)h ^ (uint)(h >> 32);
 #  elif defined(HT_KEY_MEM)
-  return ds_hash_mem(HT_KEY_LEN, &key);
+  return ds_hash_mem(HT_KEY_LEN, key);
+#  elif (defined(HT_KEY_STR) || defined(HT_KEY_STRPTR)) && defined(HT_FAST_HASH)
+#    ifdef HT_KEY_STR
+  u64 h = ds_hash_wy(key, strnlen(key, HT_KEY_LEN), HT_HASH_SEED);
+#    else
+  u64 h = ds_hash_wy(key, strlen(key), HT_HASH_SEED);
+#    endif
+  return (uint)h ^ (uint)(h >> 32);
+#  elif defined(HT_KEY_STR)
+  return ds_hash_mem(strnlen(key, HT_KEY_LEN), key);
+#  elif defined(HT_KEY_STRPTR)
+  return ds_hash_str(key);
 #  elif defined(HT_KEY_HASH)
   return HT_KEY_HASH(key);
 #  else
@@ -151,6 +559,10 @@ HT_FUNC_ATTR bool P(eq)(K a, K b) {
   return a == b;
 #  elif defined(HT_KEY_MEM)
   return memcmp(a, b, HT_KEY_LEN) == 0;
+#  elif defined(HT_KEY_STR)
+  return strncmp(a, b, HT_KEY_LEN) == 0;
+#  elif defined(HT_KEY_STRPTR)
+  return strcmp(a, b) == 0;
 #  elif defined(HT_KEY_EQ)
   return HT_KEY_EQ(a, b);
 #  else
@@ -159,26 +571,180 @@ HT_FUNC_ATTR bool P(eq)(K a, K b) {
 }
 #endif // ifndef HT_KEY_CUSTOM
 
+/**
+ * Internal. The hash used for slot selection.
+ */
+HT_FUNC_ATTR uint P(_hash)(K k) {
+#ifdef HASHES
+  uint h = ds_hash_mix(P(hash)(k));
+  return h > HASH_GRAVE ? h : h + HASH_GRAVE + 1;
+#else
+  return ds_hash_mix(P(hash)(k));
+#endif
+}
+
+#ifdef HT_COMPACT
+/**
+ * Internal. log2 of the byte width of index slots for capacity `cap`. Slots
+ * hold entry numbers up to `cap` - 1 shifted by 2.
+ */
+HT_FUNC_ATTR uint P(_ix_shift)(size_t cap) {
+  if (cap <= (1ull << 7))
+    return 0;
+  else if (cap <= (1ull << 15))
+    return 1;
+  else if (cap <= (1ull << 31))
+    return 2;
+  return 3;
+}
+
+HT_FUNC_ATTR size_t P(_ix_get)(T* t, size_t i) {
+  switch (P(_ix_shift)(t->cap)) {
+  case 0:
+    return ((u8*)t->index)[i];
+  case 1:
+    return ((u16*)t->index)[i];
+  case 2:
+    return ((u32*)t->index)[i];
+  default:
+    return ((u64*)t->index)[i];
+  }
+}
+
+HT_FUNC_ATTR void P(_ix_set)(T* t, size_t i, size_t x) {
+  switch (P(_ix_shift)(t->cap)) {
+  case 0:
+    ((u8*)t->index)[i] = (u8)x;
+    break;
+  case 1:
+    ((u16*)t->index)[i] = (u16)x;
+    break;
+  case 2:
+    ((u32*)t->index)[i] = (u32)x;
+    break;
+  default:
+    ((u64*)t->index)[i] = x;
+  }
+}
+
+/**
+ * Internal. Number of entries for index capacity `cap`. At least one index
+ * slot always stays empty so probing terminates.
+ */
+HT_FUNC_ATTR size_t P(_ecap)(size_t cap) {
+  size_t e = (size_t)(HT_MAX_DENSITY * cap);
+  return e < 1 ? 1 : e >= cap ? cap - 1 : e;
+}
+
+/**
+ * Internal. Allocates an empty index for the current capacity.
+ */
+HT_FUNC_ATTR void P(_ix_alloc)(T* t) {
+  size_t size = (size_t)t->cap << P(_ix_shift)(t->cap);
+  t->index = HT_ALLOC(t, size);
+  memset(t->index, IX_EMPTY, size);
+}
+#endif
+
+/**
+ * Internal. Allocates empty containers with capacity `cap`.
+ */
+HT_FUNC_ATTR void P(_alloc_containers)(T* t, size_t cap) {
+  t->cap = cap;
+  VARR(t->vals = HT_ALLOC(t, sizeof(V) * ECAP(t)));
+  t->keys = HT_ALLOC(t, sizeof(KS) * ECAP(t));
+#ifdef HT_CTRL
+  t->ctrl = HT_ALLOC(t, t->cap);
+  memset(t->ctrl, CTRL_EMPTY, t->cap);
+#elif defined(HT_COMPACT)
+  t->hashes = HT_ALLOC(t, sizeof(uint) * ECAP(t));
+  t->used = 0;
+  P(_ix_alloc)(t);
+#elif defined(HT_CACHE_HASH) || defined(HT_ROBIN_HOOD)
+  t->hashes = HT_ALLOC(t, sizeof(uint) * t->cap);
+  memset(t->hashes, HASH_EMPTY, sizeof(uint) * t->cap);
+#else
+  for (size_t i = 0; i < t->cap; i++)
+    MAKE_EMPTY(SLOT_KEY(t, i));
+#endif
+#ifdef HT_INCREMENTAL
+  VARR(t->ovals = NULL);
+  t->okeys = NULL;
+#endif
+}
+
+/**
+ * Internal. Frees the containers (and the old ones of a migration).
+ */
+HT_FUNC_ATTR void P(_free_containers)(T* t) {
+  VARR(HT_FREE(t, t->vals, sizeof(V) * ECAP(t)));
+  HT_FREE(t, t->keys, sizeof(KS) * ECAP(t));
+#ifdef HT_CTRL
+  HT_FREE(t, t->ctrl, t->cap);
+#endif
+#ifdef HASHES
+  HT_FREE(t, t->hashes, sizeof(uint) * ECAP(t));
+#endif
+#ifdef HT_COMPACT
+  HT_FREE(t, t->index, (size_t)t->cap << P(_ix_shift)(t->cap));
+#endif
+#ifdef HT_INCREMENTAL
+  if (t->okeys) {
+    VARR(HT_FREE(t, t->ovals, sizeof(V) * t->ocap));
+    HT_FREE(t, t->okeys, sizeof(KS) * t->ocap);
+  }
+#endif
+}
+
 HT_FUNC_ATTR void P(init)(T* t) {
   t->len = 0;
-  t->cap = 8;
   t->graves = 0;
-  t->vals = malloc(sizeof(V) * t->cap);
-  t->keys = malloc(sizeof(K) * t->cap);
-  for (size_t i = 0; i < t->cap; i++)
-    MAKE_EMPTY(t->keys[i]);
+#ifdef HT_SMALL
+  t->cap = 0; // no containers until the inline slots run out
+  memset(t->skeys, 0, sizeof(t->skeys)); // atomic keys are compared all
+#else
+  P(_alloc_containers)(t, MIN_CAP);
+#endif
+#ifdef HT_WANT_SNAPSHOT
+  t->map = NULL;
+#endif
+#ifdef HT_WANT_STATS
+  memset(&t->counters, 0, sizeof(t->counters));
+#endif
 }
 
 HT_FUNC_ATTR void P(deinit)(T* t) {
-  free(t->vals);
-  free(t->keys);
+#ifdef HT_WANT_SNAPSHOT
+  if (t->map) { // containers are in the mapping
+    munmap(t->map, t->map_len);
+    return;
+  }
+#endif
+#ifdef HT_SMALL
+  if (SMALL(t))
+    return;
+#endif
+  P(_free_containers)(t);
 }
 
 HT_FUNC_ATTR T* P(alloc)(void) {
+  T* t = calloc(1, sizeof(T)); // HT_TABLE_EXTRA_VARS start out zero
+  P(init)(t);
+  return t;
+}
+
+#ifdef HT_TABLE_EXTRA_VARS
+/**
+ * Allocs a table, copies `extra` into it and inits it, so HT_ALLOC can use the
+ * HT_TABLE_EXTRA_VARS set in `extra`. Its other fields are ignored.
+ */
+HT_FUNC_ATTR T* P(alloc_with)(const T* extra) {
   T* t = malloc(sizeof(T));
+  *t = *extra;
   P(init)(t);
   return t;
 }
+#endif
 
 HT_FUNC_ATTR void P(free)(T* t) {
   P(deinit)(t);
@@ -188,13 +754,13 @@ HT_FUNC_ATTR void P(free)(T* t) {
 #ifdef HT_WANT_PRINT
 #  include <stdio.h>
 HT_FUNC_ATTR void P(print)(T* t) {
-  printf("ht @ %p: len=%zu cap=%zu graves=%zu\n", t, t->len, t->cap, t->graves);
+  printf("ht @ %p: len=%zu cap=%zu graves=%zu\n", t, (size_t)t->len,
+         (size_t)t->cap, (size_t)t->graves);
   printf("+ - grave, . - empty, # - used\n");
   for (size_t i = 0; i < t->cap; i++) {
-    K k = t->keys[i];
-    if (IS_GRAVE(k)) {
+    if (SLOT_GRAVE(t, i)) {
       putchar('+');
-    } else if (IS_EMPTY(k)) {
+    } else if (SLOT_EMPTY(t, i)) {
       putchar('.');
     } else {
       putchar('#');
@@ -204,142 +770,1389 @@ HT_FUNC_ATTR void P(print)(T* t) {
 }
 #endif
 
+#ifdef HT_CTRL
 /**
- * Allocates new containers for keys&values and rehashes all of the values over
- * there (for grave removing and growing).
- *
- * I don't think its possible to do it inplace
+ * Internal. Bitmask of slots in the group starting at `c` whose control byte
+ * equals `b`.
  */
-HT_FUNC_ATTR void P(rehash)(T* t, size_t old_cap) {
-  t->graves = 0;
-  V* ov = t->vals; // old values
-  K* ok = t->keys; // old keys
-  t->vals = malloc(sizeof(V) * t->cap);
-  t->keys = malloc(sizeof(K) * t->cap);
-  for (size_t i = 0; i < t->cap; i++)
-    MAKE_EMPTY(t->keys[i]);
-  for (size_t i = 0; i < old_cap; i++) {
-    K b = ok[i];
-    if (!IS_EMPTY(b) && !IS_GRAVE(b)) { // rehash only non-empty non-graves
-      uint hash = P(hash)(b) % t->cap;
-      while (!IS_EMPTY(t->keys[hash])) // walk until we find empty slot
-        hash = (hash + 1) % t->cap;
-      t->keys[hash] = b; // move
-      t->vals[hash] = ov[i];
-    }
-  }
-  free(ov);
-  free(ok);
+HT_FUNC_ATTR uint P(_group_match)(const u8* c, u8 b) {
+#  ifdef __SSE2__
+  __m128i g = _mm_loadu_si128((const __m128i*)c);
+  return (uint)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)b)));
+#  else
+  uint m = 0;
+  for (uint j = 0; j < GROUP; j++)
+    m |= (uint)(c[j] == b) << j;
+  return m;
+#  endif
 }
 
-HT_FUNC_ATTR void P(_maybe_grow)(T* t) {
-  if (t->len > HT_MAX_DENSITY * t->cap) {
-    t->cap *= 2;
-    P(rehash)(t, t->cap / 2);
-  }
+/**
+ * Internal. Bitmask of empty or grave slots in the group starting at `c`.
+ * Both markers have the high bit set, hash fragments don't.
+ */
+HT_FUNC_ATTR uint P(_group_free)(const u8* c) {
+#  ifdef __SSE2__
+  return (uint)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)c));
+#  else
+  uint m = 0;
+  for (uint j = 0; j < GROUP; j++)
+    m |= (uint)(c[j] >> 7) << j;
+  return m;
+#  endif
 }
+#endif
 
-HT_FUNC_ATTR void P(_maybe_clear)(T* t) {
-  if (t->graves > HT_MAX_GRAVE * t->cap)
-    P(rehash)(t, t->cap);
+#ifdef HT_ROBIN_HOOD
+/**
+ * Internal. How far is the key in the used slot `i` from its home slot.
+ */
+HT_FUNC_ATTR size_t P(_dist)(T* t, size_t i) {
+  return (i - t->hashes[i]) & (t->cap - 1);
 }
 
 /**
- * Internal. Looks up the given key and returns its index
+ * Internal. Moves the run of keys starting at `i` one slot forward so that
+ * `i` becomes free.
  */
-HT_FUNC_ATTR size_t P(_get_key_index)(T* t, K k, bool* new) {
-  for (size_t i = P(hash)(KARGPASS) % t->cap;; i = (i + 1) % t->cap) {
-    K b = t->keys[i];
-    if (IS_GRAVE(b))
-      continue;
-    else if (IS_EMPTY(b)) {
-      *new = true;
-      return i;
-    } else if (P(eq)(b, KARGPASS))
-      return i;
-    else
-      continue;
+HT_FUNC_ATTR void P(_shift)(T* t, size_t i) {
+  size_t mask = t->cap - 1;
+  size_t j = i;
+  while (!SLOT_EMPTY(t, j)) // find the end of the run
+    j = (j + 1) & mask;
+  for (; j != i; j = (j - 1) & mask) {
+    t->hashes[j] = t->hashes[(j - 1) & mask];
+    SLOT_KEY(t, j) = SLOT_KEY(t, (j - 1) & mask);
+    VAL(SLOT_VAL(t, j) = SLOT_VAL(t, (j - 1) & mask));
   }
 }
+#endif
 
+#ifdef HT_INCREMENTAL
 /**
- * Finds a value with given key and returns a pointer to it. Returns NULL if the
- * key is not present
+ * Internal. Moves up to `n` old slots into the current containers and frees
+ * the old containers once all of them were moved.
  */
-HT_FUNC_ATTR V* P(lookup)(T* t, KARG) {
-  bool new = false;
-  size_t i = P(_get_key_index)(t, KARGPASS, &new);
-  return new ? NULL : &t->vals[i];
+HT_FUNC_ATTR void P(_migrate)(T* t, size_t n) {
+  STAT(u64 t0 = P(_ns)());
+  size_t mask = t->cap - 1;
+  for (; n && t->opos < t->ocap; n--, t->opos++) {
+    K b = KEY_AT(t->okeys, t->opos);
+    if (IS_EMPTY(b) || IS_GRAVE(b))
+      continue;
+    size_t i = P(_hash)(b) & mask;
+    while (!IS_EMPTY(SLOT_KEY(t, i))) // walk until we find empty slot
+      i = (i + 1) & mask;
+    SLOT_KEY(t, i) = b; // move
+    VAL(SLOT_VAL(t, i) = VAL_AT(t->okeys, t->ovals, t->opos));
+    // keep the old probe paths going through this slot intact
+    MAKE_GRAVE(KEY_AT(t->okeys, t->opos));
+  }
+  if (t->opos == t->ocap) {
+    VARR(HT_FREE(t, t->ovals, sizeof(V) * t->ocap));
+    HT_FREE(t, t->okeys, sizeof(KS) * t->ocap);
+    VARR(t->ovals = NULL);
+    t->okeys = NULL;
+  }
+  STAT(t->counters.rehash_ns += P(_ns)() - t0);
 }
 
 /**
- * Inserts a new key-value pair. If the key is already present returns false.
- * Otherwise returns true
+ * Internal. Sets the current containers aside and starts migrating them into
+ * new ones with capacity `cap`.
  */
-HT_FUNC_ATTR bool P(insert)(T* t, K k, V v) {
-  bool new = false;
-  size_t i = P(_get_key_index)(t, k, &new);
-  if (!new)
-    return false;
-  t->keys[i] = k;
-  t->vals[i] = v;
-  t->len++;
-  P(_maybe_grow)(t);
-  return true;
+HT_FUNC_ATTR void P(_start_migration)(T* t, size_t cap) {
+  if (t->okeys) // didn't finish in time, shouldn't happen with sane step
+    P(_migrate)(t, SIZE_MAX);
+  STAT(t->counters.rehashes++);
+  t->graves = 0;
+  VARR(t->ovals = t->vals);
+  t->okeys = t->keys;
+  t->ocap = t->cap;
+  t->opos = 0;
+  t->cap = cap;
+  VARR(t->vals = HT_ALLOC(t, sizeof(V) * t->cap));
+  t->keys = HT_ALLOC(t, sizeof(KS) * t->cap);
+  for (size_t i = 0; i < t->cap; i++)
+    MAKE_EMPTY(SLOT_KEY(t, i));
 }
 
 /**
- * Updates the value behind the given key.
- * Inserts a new key-value pair if needed.
+ * Internal. Index of key `k` with hash `h` in the old containers or SIZE_MAX
+ * if it's not there.
  */
-HT_FUNC_ATTR void P(update)(T* t, K k, V v) {
-  bool new = false;
-  size_t i = P(_get_key_index)(t, k, &new);
-  if (new) {
-    t->keys[i] = k;
-    t->vals[i] = v;
-    t->len++;
-    P(_maybe_grow)(t);
-  } else {
-    t->vals[i] = v;
+HT_FUNC_ATTR size_t P(_old_index)(T* t, K k, uint h) {
+  size_t mask = t->ocap - 1;
+  for (size_t i = h & mask;; i = (i + 1) & mask) {
+    K b = KEY_AT(t->okeys, i);
+    if (IS_EMPTY(b))
+      return SIZE_MAX;
+    else if (!IS_GRAVE(b) && P(eq)(b, k))
+      return i;
   }
 }
+#endif
 
 /**
- * Removes a key.
+ * Allocates new containers for keys&values and rehashes all of the values over
+ * there (for grave removing and growing).
+ *
+ * I don't think its possible to do it inplace
  */
-HT_FUNC_ATTR V P(remove)(T* t, K k, bool* b) {
-  bool new = false;
-  size_t i = P(_get_key_index)(t, k, &new);
-  if (new) {
-    *b = false;
-    return 0;
+#ifdef HT_COMPACT
+HT_FUNC_ATTR void P(rehash)(T* t, size_t old_cap) {
+  STAT(u64 t0 = P(_ns)());
+  // close the holes of removed entries, keeping the insertion order
+  size_t n = 0;
+  for (size_t e = 0; e < t->used; e++) {
+    if (t->hashes[e] == HASH_GRAVE)
+      continue;
+    if (n != e) {
+      t->hashes[n] = t->hashes[e];
+      memcpy(&SLOT_KEY(t, n), &SLOT_KEY(t, e), sizeof(K));
+      VAL(SLOT_VAL(t, n) = SLOT_VAL(t, e));
+    }
+    n++;
   }
-  V v = t->vals[i];
-  MAKE_GRAVE(t->keys[i]);
-  t->graves++;
-  *b = true;
-  P(_maybe_clear)(t);
-  return v;
+  size_t oe = P(_ecap)(old_cap);
+  if (oe != ECAP(t)) {
+    VARR(V* ov = t->vals);
+    KS* ok = t->keys;
+    uint* oh = t->hashes;
+    VARR(t->vals = HT_ALLOC(t, sizeof(V) * ECAP(t)));
+    t->keys = HT_ALLOC(t, sizeof(KS) * ECAP(t));
+    t->hashes = HT_ALLOC(t, sizeof(uint) * ECAP(t));
+    VARR(memcpy(t->vals, ov, sizeof(V) * n));
+    memcpy(t->keys, ok, sizeof(KS) * n);
+    memcpy(t->hashes, oh, sizeof(uint) * n);
+    VARR(HT_FREE(t, ov, sizeof(V) * oe));
+    HT_FREE(t, ok, sizeof(KS) * oe);
+    HT_FREE(t, oh, sizeof(uint) * oe);
+  }
+  HT_FREE(t, t->index, old_cap << P(_ix_shift)(old_cap));
+  P(_ix_alloc)(t);
+  size_t mask = t->cap - 1;
+  for (size_t e = 0; e < n; e++) {
+    size_t j = t->hashes[e] & mask;
+    while (!SLOT_EMPTY(t, j)) // walk until we find empty slot
+      j = (j + 1) & mask;
+    P(_ix_set)(t, j, e + 2);
+  }
+  t->used = n;
+  t->graves = 0;
+  STAT(t->counters.rehashes++);
+  STAT(t->counters.rehash_ns += P(_ns)() - t0);
 }
-
-HT_FUNC_ATTR bool P(contains)(T* t, K k) {
-  bool new = false;
-  P(_get_key_index)(t, k, &new);
-  return !new;
+#else
+HT_FUNC_ATTR void P(rehash)(T* t, size_t old_cap) {
+#ifdef HT_INCREMENTAL
+  if (t->okeys) { // finish the running migration first
+    size_t cap = t->cap;
+    t->cap = old_cap;
+    P(_migrate)(t, SIZE_MAX);
+    t->cap = cap;
+  }
+#endif
+  STAT(u64 t0 = P(_ns)());
+  t->graves = 0;
+  VARR(V* ov = t->vals); // old values
+  KS* ok = t->keys;      // old keys
+  VARR(t->vals = HT_ALLOC(t, sizeof(V) * t->cap));
+  t->keys = HT_ALLOC(t, sizeof(KS) * t->cap);
+#ifdef HT_CTRL
+  size_t mask = t->cap - 1;
+  u8* oc = t->ctrl; // old control bytes
+  t->ctrl = HT_ALLOC(t, t->cap);
+  memset(t->ctrl, CTRL_EMPTY, t->cap);
+  for (size_t i = 0; i < old_cap; i++) {
+    if (oc[i] & 0x80) // skip empty and graves
+      continue;
+    uint h = P(_hash)(KEY_AT(ok, i));
+    size_t g = (CTRL_H1(h) * GROUP) & mask;
+    uint f;
+    while (!(f = P(_group_free)(t->ctrl + g))) // walk until a group has space
+      g = (g + GROUP) & mask;
+    size_t j = g + __builtin_ctz(f);
+    t->ctrl[j] = CTRL_H2(h);
+    SLOT_KEY(t, j) = KEY_AT(ok, i); // move
+    VAL(SLOT_VAL(t, j) = VAL_AT(ok, ov, i));
+  }
+  HT_FREE(t, oc, old_cap);
+#elif defined(HT_CACHE_HASH)
+  size_t mask = t->cap - 1;
+  uint* oh = t->hashes; // old hashes
+  t->hashes = HT_ALLOC(t, sizeof(uint) * t->cap);
+  memset(t->hashes, HASH_EMPTY, sizeof(uint) * t->cap);
+  for (size_t i = 0; i < old_cap; i++) {
+    if (oh[i] <= HASH_GRAVE) // skip empty and graves
+      continue;
+    size_t j = oh[i] & mask;
+    while (!SLOT_EMPTY(t, j)) // walk until we find empty slot
+      j = (j + 1) & mask;
+    t->hashes[j] = oh[i];
+    KEY_MOVE(SLOT_KEY(t, j), KEY_AT(ok, i)); // move
+    VAL(SLOT_VAL(t, j) = VAL_AT(ok, ov, i));
+  }
+  HT_FREE(t, oh, sizeof(uint) * old_cap);
+#elif defined(HT_ROBIN_HOOD)
+  size_t mask = t->cap - 1;
+  uint* oh = t->hashes; // old hashes
+  t->hashes = HT_ALLOC(t, sizeof(uint) * t->cap);
+  memset(t->hashes, HASH_EMPTY, sizeof(uint) * t->cap);
+  for (size_t i = 0; i < old_cap; i++) {
+    if (oh[i] == HASH_EMPTY)
+      continue;
+    size_t j = oh[i] & mask;
+    // walk past keys that are at least as far from home as we are
+    for (size_t d = 0; !SLOT_EMPTY(t, j) && P(_dist)(t, j) >= d; d++)
+      j = (j + 1) & mask;
+    P(_shift)(t, j);
+    t->hashes[j] = oh[i];
+    SLOT_KEY(t, j) = KEY_AT(ok, i); // move
+    VAL(SLOT_VAL(t, j) = VAL_AT(ok, ov, i));
+  }
+  HT_FREE(t, oh, sizeof(uint) * old_cap);
+#else
+  size_t mask = t->cap - 1;
+  for (size_t i = 0; i < t->cap; i++)
+    MAKE_EMPTY(SLOT_KEY(t, i));
+  for (size_t i = 0; i < old_cap; i++) {
+    K b = KEY_AT(ok, i);
+    if (!IS_EMPTY(b) && !IS_GRAVE(b)) { // rehash only non-empty non-graves
+      size_t hash = P(_hash)(b) & mask;
+      while (!IS_EMPTY(SLOT_KEY(t, hash))) // walk until we find empty slot
+        hash = (hash + 1) & mask;
+      SLOT_KEY(t, hash) = b; // move
+      VAL(SLOT_VAL(t, hash) = VAL_AT(ok, ov, i));
+    }
+  }
+#endif
+  VARR(HT_FREE(t, ov, sizeof(V) * old_cap));
+  HT_FREE(t, ok, sizeof(KS) * old_cap);
+  STAT(t->counters.rehashes++);
+  STAT(t->counters.rehash_ns += P(_ns)() - t0);
 }
+#endif
 
-#undef P
-#undef T
+/**
+ * Internal. Smallest capacity that holds `n` elements without growing.
+ */
+HT_FUNC_ATTR size_t P(_cap_for)(size_t n) {
+  size_t cap = MIN_CAP;
+#ifdef HT_COMPACT
+  while (n >= P(_ecap)(cap))
+#else
+  while (n > HT_MAX_DENSITY * cap)
+#endif
+    cap *= 2;
+  return cap;
+}
+
+/**
+ * Internal. Rehashes the table into containers with capacity `cap`.
+ */
+HT_FUNC_ATTR void P(_resize)(T* t, size_t cap) {
+  size_t old_cap = t->cap;
+  t->cap = cap;
+  P(rehash)(t, old_cap);
+}
+
+/**
+ * Internal. Whether the table has to grow or be cleared of graves once it
+ * holds `extra` more elements.
+ */
+HT_FUNC_ATTR bool P(_over)(T* t, size_t extra) {
+#ifdef HT_COMPACT
+  return t->used + extra >= ECAP(t);
+#else
+  // Graves end probes no more than keys do. Counting them keeps some slots
+  // empty for any HT_MAX_DENSITY below 1, or a miss would probe forever.
+  return t->len + t->graves + extra > HT_MAX_DENSITY * t->cap;
+#endif
+}
+
+/**
+ * Internal. Makes room for one more element after _over. Doubles the
+ * capacity unless clearing the graves leaves room for cap / 8 more inserts,
+ * so churn at full load doesn't rehash in place on every insert.
+ */
+HT_FUNC_ATTR void P(_grow)(T* t) {
+  size_t old_cap = t->cap;
+#ifdef HT_COMPACT
+  // Out of entries. Grow only if the live ones take more than half of them,
+  // otherwise closing the holes of removed entries makes enough room.
+  if (t->len > ECAP(t) / 2)
+    t->cap *= 2;
+  P(rehash)(t, old_cap);
+#else
+  size_t cap = old_cap;
+  if (t->len + cap / 8 > HT_MAX_DENSITY * cap)
+    cap *= 2;
+#  ifdef HT_INCREMENTAL
+  P(_start_migration)(t, cap);
+#  else
+  t->cap = cap;
+  P(rehash)(t, old_cap);
+#  endif
+#endif
+}
+
+HT_FUNC_ATTR void P(_maybe_clear)(T* t) {
+  size_t cap = t->cap;
+  if (t->cap > MIN_CAP && t->len < HT_MIN_DENSITY * t->cap)
+    cap = P(_cap_for)(t->len); // shrink, leaves the density at least doubled
+  else if (t->graves <= HT_MAX_GRAVE * t->cap)
+    return;
+#ifdef HT_INCREMENTAL
+  P(_start_migration)(t, cap);
+#else
+  P(_resize)(t, cap);
+#endif
+}
+
+/**
+ * Internal. Looks up the given key with hash `h` and returns its index.
+ * If the key is not present, sets `new` and returns the index where it should
+ * be inserted.
+ */
+#ifdef HT_CTRL
+HT_FUNC_ATTR size_t P(_get_key_index)(T* t, K k, uint h, bool* new) {
+  size_t mask = t->cap - 1;
+  STAT(t->counters.lookups++);
+  size_t slot = SIZE_MAX; // first free slot on the probe path
+  for (size_t g = (CTRL_H1(h) * GROUP) & mask;; g = (g + GROUP) & mask) {
+    STAT(t->counters.probes++);
+    const u8* c = t->ctrl + g;
+    for (uint m = P(_group_match)(c, CTRL_H2(h)); m; m &= m - 1) {
+      size_t i = g + __builtin_ctz(m);
+      if (P(eq)(SLOT_KEY(t, i), k))
+        return i;
+    }
+    if (slot == SIZE_MAX) {
+      uint f = P(_group_free)(c);
+      if (f)
+        slot = g + __builtin_ctz(f);
+    }
+    if (P(_group_match)(c, CTRL_EMPTY)) { // the key would have been here
+      STAT(t->counters.misses++);
+      *new = true;
+      return slot;
+    }
+  }
+}
+#elif defined(HT_ROBIN_HOOD)
+HT_FUNC_ATTR size_t P(_get_key_index)(T* t, K k, uint h, bool* new) {
+  size_t mask = t->cap - 1;
+  STAT(t->counters.lookups++);
+  for (size_t i = h & mask, d = 0;; i = (i + 1) & mask, d++) {
+    STAT(t->counters.probes++);
+    // Keys are ordered by home slot, meeting a key that is closer to its home
+    // means ours would have been placed before it.
+    if (SLOT_EMPTY(t, i) || P(_dist)(t, i) < d) {
+      STAT(t->counters.misses++);
+      *new = true;
+      return i;
+    } else if (t->hashes[i] == h && P(eq)(SLOT_KEY(t, i), k))
+      return i;
+  }
+}
+#elif defined(HT_COMPACT)
+// Returns the entry of the key if it's present, otherwise the index slot.
+HT_FUNC_ATTR size_t P(_get_key_index)(T* t, K k, uint h, bool* new) {
+  size_t mask = t->cap - 1;
+  STAT(t->counters.lookups++);
+  for (size_t i = h & mask;; i = (i + 1) & mask) {
+    STAT(t->counters.probes++);
+    size_t x = P(_ix_get)(t, i);
+    if (x == IX_EMPTY) {
+      STAT(t->counters.misses++);
+      *new = true;
+      return i;
+    } else if (x != IX_GRAVE && t->hashes[x - 2] == h &&
+               P(eq)(SLOT_KEY(t, x - 2), k))
+      return x - 2;
+  }
+}
+#elif defined(HT_CACHE_HASH)
+HT_FUNC_ATTR size_t P(_get_key_index)(T* t, K k, uint h, bool* new) {
+  size_t mask = t->cap - 1;
+  STAT(t->counters.lookups++);
+  for (size_t i = h & mask;; i = (i + 1) & mask) {
+    STAT(t->counters.probes++);
+    uint b = t->hashes[i];
+    if (b == HASH_EMPTY) {
+      STAT(t->counters.misses++);
+      *new = true;
+      return i;
+    } else if (b == h && P(eq)(SLOT_KEY(t, i), k)) // graves never match
+      return i;
+  }
+}
+#else
+HT_FUNC_ATTR size_t P(_get_key_index)(T* t, K k, uint h, bool* new) {
+  size_t mask = t->cap - 1;
+  STAT(t->counters.lookups++);
+  for (size_t i = h & mask;; i = (i + 1) & mask) {
+    STAT(t->counters.probes++);
+    K b = SLOT_KEY(t, i);
+    if (IS_GRAVE(b))
+      continue;
+    else if (IS_EMPTY(b)) {
+      STAT(t->counters.misses++);
+      *new = true;
+      return i;
+    } else if (P(eq)(b, KARGPASS))
+      return i;
+    else
+      continue;
+  }
+}
+#endif
+
+/**
+ * Internal. Like _get_key_index but for operations that modify the table.
+ * While migrating, advances the migration and moves the key over from the old
+ * containers so the returned index always points to the current ones.
+ */
+HT_FUNC_ATTR size_t P(_get_key_index_w)(T* t, K k, uint h, bool* new) {
+#ifdef HT_INCREMENTAL
+  if (t->okeys)
+    P(_migrate)(t, HT_MIGRATE_STEP);
+  size_t i = P(_get_key_index)(t, k, h, new);
+  size_t oi;
+  if (*new && t->okeys && (oi = P(_old_index)(t, k, h)) != SIZE_MAX) {
+    SLOT_KEY(t, i) = KEY_AT(t->okeys, oi);
+    VAL(SLOT_VAL(t, i) = VAL_AT(t->okeys, t->ovals, oi));
+    MAKE_GRAVE(KEY_AT(t->okeys, oi));
+    *new = false;
+  }
+  return i;
+#else
+  return P(_get_key_index)(t, k, h, new);
+#endif
+}
+
+/**
+ * Internal. Stores a new key with hash `h` into the slot `i` returned by
+ * _get_key_index. Returns the index where its value goes.
+ */
+HT_FUNC_ATTR size_t P(_occupy)(T* t, size_t i, K k, ds_unused uint h) {
+#ifdef HT_COMPACT
+  size_t e = t->used++;
+  P(_ix_set)(t, i, e + 2);
+  t->hashes[e] = h;
+  i = e;
+#elif defined(HT_CTRL)
+  if (SLOT_GRAVE(t, i))
+    t->graves--;
+  t->ctrl[i] = CTRL_H2(h);
+#elif defined(HT_CACHE_HASH)
+  t->hashes[i] = h;
+#elif defined(HT_ROBIN_HOOD)
+  P(_shift)(t, i);
+  t->hashes[i] = h;
+#endif
+  KEY_MOVE(SLOT_KEY(t, i), k);
+  t->len++;
+  return i;
+}
+
+/**
+ * Internal. Turns the used slot `i` into a grave (or frees it right away).
+ * With HT_COMPACT `i` is the entry.
+ */
+HT_FUNC_ATTR void P(_vacate)(T* t, size_t i) {
+  t->len--;
+#ifdef HT_COMPACT
+  size_t mask = t->cap - 1;
+  size_t j = t->hashes[i] & mask;
+  while (P(_ix_get)(t, j) != i + 2) // find the index slot of the entry
+    j = (j + 1) & mask;
+  P(_ix_set)(t, j, IX_GRAVE);
+  t->hashes[i] = HASH_GRAVE;
+#elif defined(HT_CTRL)
+  // Lookups stop at the first group with an empty slot so no probe path
+  // continues past this group and the slot can become empty right away.
+  if (P(_group_match)(t->ctrl + (i & ~(size_t)(GROUP - 1)), CTRL_EMPTY)) {
+    t->ctrl[i] = CTRL_EMPTY;
+    return;
+  }
+  t->ctrl[i] = CTRL_GRAVE;
+#elif defined(HT_ROBIN_HOOD)
+  // backward shift: pull the following keys one slot closer to their home
+  size_t mask = t->cap - 1;
+  size_t j = (i + 1) & mask;
+  for (; !SLOT_EMPTY(t, j) && P(_dist)(t, j) > 0; i = j, j = (j + 1) & mask) {
+    t->hashes[i] = t->hashes[j];
+    SLOT_KEY(t, i) = SLOT_KEY(t, j);
+    VAL(SLOT_VAL(t, i) = SLOT_VAL(t, j));
+  }
+  t->hashes[i] = HASH_EMPTY;
+  return;
+#elif defined(HT_CACHE_HASH)
+  t->hashes[i] = HASH_GRAVE;
+#else
+  MAKE_GRAVE(SLOT_KEY(t, i));
+#endif
+  t->graves++;
+  STAT(t->counters.graves++);
+}
+
+/**
+ * Internal. Whether key `k` with hash `h` is present.
+ */
+HT_FUNC_ATTR bool P(_contains_h)(T* t, K k, uint h) {
+  bool new = false;
+  P(_get_key_index)(t, k, h, &new);
+#ifdef HT_INCREMENTAL
+  if (new && t->okeys)
+    return P(_old_index)(t, k, h) != SIZE_MAX;
+#endif
+  return !new;
+}
+
+#ifndef HT_SET
+/**
+ * Internal. Lookup with an already computed hash.
+ */
+HT_FUNC_ATTR V* P(_lookup_h)(T* t, K k, uint h) {
+  bool new = false;
+  size_t i = P(_get_key_index)(t, k, h, &new);
+#  ifdef HT_INCREMENTAL
+  if (new && t->okeys) {
+    size_t oi = P(_old_index)(t, k, h);
+    return oi == SIZE_MAX ? NULL : &VAL_AT(t->okeys, t->ovals, oi);
+  }
+#  endif
+  return new ? NULL : &SLOT_VAL(t, i);
+}
+#endif
+
+/**
+ * Internal. Places the new key `k` into slot `i` from _get_key_index_w and
+ * returns the index of its value. Grows the table first if needed, so the
+ * index stays valid.
+ */
+HT_FUNC_ATTR size_t P(_place)(T* t, size_t i, K k, uint h) {
+  if (P(_over)(t, 1)) {
+    bool new;
+    P(_grow)(t);
+    i = P(_get_key_index_w)(t, k, h, &new);
+  }
+  return P(_occupy)(t, i, k, h);
+}
+
+/**
+ * Internal. entry with an already computed hash, returns the index of the
+ * value.
+ */
+HT_FUNC_ATTR size_t P(_entry_h)(T* t, K k, uint h, bool* new) {
+  bool n = false;
+  size_t i = P(_get_key_index_w)(t, k, h, &n);
+  *new = n;
+  return n ? P(_place)(t, i, k, h) : i;
+}
+
+/**
+ * Internal. Insert with an already computed hash.
+ */
+HT_FUNC_ATTR bool P(_insert_h)(T* t, K k, VAL(V v, ) uint h) {
+  bool new;
+  ds_unused size_t i = P(_entry_h)(t, k, h, &new);
+  VAL(if (new) SLOT_VAL(t, i) = v);
+  return new;
+}
+
+#ifdef HT_SMALL
+/**
+ * Internal. Index of key `k` in the inline slots, SIZE_MAX if it's not there.
+ */
+HT_FUNC_ATTR size_t P(_small_index)(T* t, K k) {
+#  ifdef HT_KEY_ATOMIC
+  // compares all the slots without branches so that it gets vectorized
+  u64 m = 0;
+  for (size_t i = 0; i < HT_SMALL; i++)
+    m |= (u64)(t->skeys[i] == k) << i;
+  m &= ((u64)1 << t->len) - 1;
+  return m ? (size_t)__builtin_ctzll(m) : SIZE_MAX;
+#  else
+  for (size_t i = 0; i < t->len; i++)
+    if (P(eq)(t->skeys[i], k))
+      return i;
+  return SIZE_MAX;
+#  endif
+}
+
+/**
+ * Internal. Moves the elements from the inline slots into new containers with
+ * capacity `cap`.
+ */
+HT_FUNC_ATTR void P(_spill)(T* t, size_t cap) {
+  size_t n = t->len;
+  t->len = 0;
+  P(_alloc_containers)(t, cap);
+  for (size_t i = 0; i < n; i++)
+    P(_insert_h)(t, t->skeys[i], VAL(t->svals[i], ) P(_hash)(t->skeys[i]));
+}
+
+/**
+ * Internal. entry for the inline slots, returns the slot of `k`. When they are
+ * full the table spills into containers and SIZE_MAX is returned, the caller
+ * continues with the containers then.
+ */
+HT_FUNC_ATTR size_t P(_small_entry)(T* t, K k, bool* new) {
+  size_t i = P(_small_index)(t, k);
+  *new = i == SIZE_MAX;
+  if (!*new)
+    return i;
+  if (t->len == HT_SMALL) {
+    P(_spill)(t, P(_cap_for)(HT_SMALL + 1));
+    return SIZE_MAX;
+  }
+  KEY_MOVE(t->skeys[t->len], k);
+  return t->len++;
+}
+
+/**
+ * Internal. Removes the element in inline slot `i`, the last one takes its
+ * place.
+ */
+HT_FUNC_ATTR void P(_small_vacate)(T* t, size_t i) {
+  t->len--;
+  memmove(&t->skeys[i], &t->skeys[t->len], sizeof(K));
+  VAL(t->svals[i] = t->svals[t->len]);
+}
+#endif
+
+#ifdef HT_SET
+/**
+ * Adds a key to the set. Returns false if it was already there.
+ */
+HT_FUNC_ATTR bool P(add)(T* t, K k) {
+#  ifdef HT_SMALL
+  bool new;
+  if (SMALL(t) && P(_small_entry)(t, k, &new) != SIZE_MAX)
+    return new;
+#  endif
+  return P(_insert_h)(t, k, P(_hash)(k));
+}
+
+/**
+ * Removes a key from the set. Returns false if it wasn't there.
+ */
+HT_FUNC_ATTR bool P(remove)(T* t, K k) {
+#  ifdef HT_SMALL
+  if (SMALL(t)) {
+    size_t i = P(_small_index)(t, k);
+    if (i == SIZE_MAX)
+      return false;
+    P(_small_vacate)(t, i);
+    return true;
+  }
+#  endif
+  bool new = false;
+  size_t i = P(_get_key_index_w)(t, k, P(_hash)(k), &new);
+  if (new)
+    return false;
+  P(_vacate)(t, i);
+  P(_maybe_clear)(t);
+  return true;
+}
+#else
+/**
+ * Finds a value with given key and returns a pointer to it. Returns NULL if the
+ * key is not present
+ */
+HT_FUNC_ATTR V* P(lookup)(T* t, KARG) {
+#  ifdef HT_SMALL
+  if (SMALL(t)) {
+    size_t i = P(_small_index)(t, KARGPASS);
+    return i == SIZE_MAX ? NULL : &t->svals[i];
+  }
+#  endif
+  return P(_lookup_h)(t, KARGPASS, P(_hash)(KARGPASS));
+}
+
+/**
+ * Inserts a new key-value pair. If the key is already present returns false.
+ * Otherwise returns true
+ */
+HT_FUNC_ATTR bool P(insert)(T* t, K k, V v) {
+#  ifdef HT_SMALL
+  bool new;
+  size_t i;
+  if (SMALL(t) && (i = P(_small_entry)(t, k, &new)) != SIZE_MAX) {
+    if (new)
+      t->svals[i] = v;
+    return new;
+  }
+#  endif
+  return P(_insert_h)(t, k, v, P(_hash)(k));
+}
+
+/**
+ * Updates the value behind the given key.
+ * Inserts a new key-value pair if needed.
+ */
+HT_FUNC_ATTR void P(update)(T* t, K k, V v) {
+  bool new;
+#  ifdef HT_SMALL
+  size_t s;
+  if (SMALL(t) && (s = P(_small_entry)(t, k, &new)) != SIZE_MAX) {
+    t->svals[s] = v;
+    return;
+  }
+#  endif
+  size_t i = P(_entry_h)(t, k, P(_hash)(k), &new); // may reallocate vals
+  SLOT_VAL(t, i) = v;
+}
+
+/**
+ * Finds the value of a key with a single probe, inserting the key if it's not
+ * present. Returns a pointer to the value and sets `new` if the key was
+ * inserted, the value is left uninitialized then. The pointer is valid until
+ * the next modification of the table.
+ */
+HT_FUNC_ATTR V* P(entry)(T* t, K k, bool* new) {
+#  ifdef HT_SMALL
+  size_t s;
+  if (SMALL(t) && (s = P(_small_entry)(t, k, new)) != SIZE_MAX)
+    return &t->svals[s];
+#  endif
+  size_t i = P(_entry_h)(t, k, P(_hash)(k), new);
+  return &SLOT_VAL(t, i);
+}
+
+/**
+ * Like entry but initializes the value of a new key to `v`.
+ */
+HT_FUNC_ATTR V* P(get_or_insert)(T* t, K k, V v) {
+  bool new;
+#  ifdef HT_SMALL
+  size_t s;
+  if (SMALL(t) && (s = P(_small_entry)(t, k, &new)) != SIZE_MAX) {
+    if (new)
+      t->svals[s] = v;
+    return &t->svals[s];
+  }
+#  endif
+  size_t i = P(_entry_h)(t, k, P(_hash)(k), &new);
+  if (new)
+    SLOT_VAL(t, i) = v;
+  return &SLOT_VAL(t, i);
+}
+
+/**
+ * Removes a key.
+ */
+HT_FUNC_ATTR V P(remove)(T* t, K k, bool* b) {
+#  ifdef HT_SMALL
+  if (SMALL(t)) {
+    size_t i = P(_small_index)(t, k);
+    *b = i != SIZE_MAX;
+    if (!*b)
+      return (V){0};
+    V v = t->svals[i];
+    P(_small_vacate)(t, i);
+    return v;
+  }
+#  endif
+  bool new = false;
+  size_t i = P(_get_key_index_w)(t, k, P(_hash)(k), &new);
+  if (new) {
+    *b = false;
+    return (V){0};
+  }
+  V v = SLOT_VAL(t, i);
+  P(_vacate)(t, i);
+  *b = true;
+  P(_maybe_clear)(t);
+  return v;
+}
+#endif
+
+HT_FUNC_ATTR bool P(contains)(T* t, K k) {
+#ifdef HT_SMALL
+  if (SMALL(t))
+    return P(_small_index)(t, k) != SIZE_MAX;
+#endif
+  return P(_contains_h)(t, k, P(_hash)(k));
+}
+
+/**
+ * Cursor over all key-value pairs (keys of a set, without `v`). Start with
+ * `*it` = 0, each call points `k` and `v` at the next pair and returns false
+ * once there are no more. The table must not be modified while iterating,
+ * except for the values. With HT_COMPACT the pairs come in insertion order.
+ */
+HT_FUNC_ATTR bool P(next)(T* t, size_t* it, K** k VAL(, V** v)) {
+#ifdef HT_SMALL
+  if (SMALL(t)) {
+    if (*it >= t->len)
+      return false;
+    *k = &t->skeys[*it];
+    VAL(*v = &t->svals[*it]);
+    (*it)++;
+    return true;
+  }
+#endif
+#ifdef HT_COMPACT
+  for (size_t i = *it; i < t->used; i++) {
+    if (t->hashes[i] != HASH_GRAVE) {
+      *it = i + 1;
+      *k = &SLOT_KEY(t, i);
+      VAL(*v = &SLOT_VAL(t, i));
+      return true;
+    }
+  }
+#else
+  for (size_t i = *it; i < t->cap; i++) {
+    if (!SLOT_EMPTY(t, i) && !SLOT_GRAVE(t, i)) {
+      *it = i + 1;
+      *k = &SLOT_KEY(t, i);
+      VAL(*v = &SLOT_VAL(t, i));
+      return true;
+    }
+  }
+#  ifdef HT_INCREMENTAL
+  // slots that weren't migrated yet continue after the current ones
+  for (size_t i = ds_max(*it, t->cap) - t->cap; t->okeys && i < t->ocap; i++) {
+    K b = KEY_AT(t->okeys, i);
+    if (!IS_EMPTY(b) && !IS_GRAVE(b)) {
+      *it = t->cap + i + 1;
+      *k = &KEY_AT(t->okeys, i);
+      VAL(*v = &VAL_AT(t->okeys, t->ovals, i));
+      return true;
+    }
+  }
+#  endif
+#endif
+  return false;
+}
+
+#ifdef HT_SMALL
+/**
+ * Internal. Moves the elements back into the inline slots and frees the
+ * containers. The table must hold at most HT_SMALL elements.
+ */
+HT_FUNC_ATTR void P(_unspill)(T* t) {
+  size_t it = 0, n = 0;
+  K* k;
+  VAL(V* v);
+  while (P(next)(t, &it, &k VAL(, &v))) {
+    memcpy(&t->skeys[n], k, sizeof(K));
+    VAL(t->svals[n] = *v);
+    n++;
+  }
+  P(_free_containers)(t);
+  t->cap = 0;
+  t->graves = 0;
+}
+#endif
+
+/**
+ * Grows the table so that it holds `n` elements without rehashing.
+ */
+HT_FUNC_ATTR void P(reserve)(T* t, size_t n) {
+#ifdef HT_SMALL
+  if (SMALL(t)) {
+    if (n > HT_SMALL)
+      P(_spill)(t, P(_cap_for)(n));
+    return;
+  }
+#endif
+  size_t cap = P(_cap_for)(n);
+  if (cap > t->cap)
+    P(_resize)(t, cap);
+}
+
+/**
+ * Shrinks the table to the smallest capacity that holds its elements and
+ * clears the graves. With HT_SMALL, up to HT_SMALL elements go back into the
+ * inline slots.
+ */
+HT_FUNC_ATTR void P(shrink_to_fit)(T* t) {
+#ifdef HT_SMALL
+  if (SMALL(t))
+    return;
+  if (t->len <= HT_SMALL) {
+    P(_unspill)(t);
+    return;
+  }
+#endif
+  P(_resize)(t, P(_cap_for)(t->len));
+}
+
+/**
+ * Internal. The slot where probing for hash `h` starts.
+ */
+HT_FUNC_ATTR size_t P(_home)(T* t, uint h) {
+#ifdef HT_CTRL
+  return (CTRL_H1(h) * GROUP) & (t->cap - 1);
+#else
+  return h & (t->cap - 1);
+#endif
+}
+
+/**
+ * Internal. Prefetches the start of the probe path for hash `h`.
+ */
+HT_FUNC_ATTR void P(_prefetch)(T* t, uint h) {
+  size_t i = P(_home)(t, h);
+#ifdef HT_COMPACT
+  // the entry isn't known before the index is read
+  ds_prefetch((byte*)t->index + (i << P(_ix_shift)(t->cap)));
+#else
+#  ifdef HT_CTRL
+  ds_prefetch(t->ctrl + i);
+#  elif defined(HASHES)
+  ds_prefetch(t->hashes + i);
+#  endif
+  ds_prefetch(t->keys + i);
+#endif
+}
+
+#ifndef HT_SET
+/**
+ * Looks up `n` keys at once and stores pointers to their values (or NULL) to
+ * `out`. Hashes of a whole batch are computed and their slots prefetched
+ * before probing, so the cache misses of different keys overlap.
+ */
+HT_FUNC_ATTR void P(lookup_batch)(T* t, size_t n, K* keys, V** out) {
+#  ifdef HT_SMALL
+  if (SMALL(t)) { // nothing to prefetch
+    for (size_t j = 0; j < n; j++)
+      out[j] = P(lookup)(t, keys[j]);
+    return;
+  }
+#  endif
+  uint h[HT_BATCH];
+  for (size_t b = 0; b < n; b += HT_BATCH) {
+    size_t m = ds_min(n - b, (size_t)HT_BATCH);
+    for (size_t j = 0; j < m; j++) {
+      h[j] = P(_hash)(keys[b + j]);
+      P(_prefetch)(t, h[j]);
+    }
+    for (size_t j = 0; j < m; j++) {
+      out[b + j] = P(_lookup_h)(t, keys[b + j], h[j]);
+      if (out[b + j])
+        ds_prefetch(out[b + j]);
+    }
+  }
+}
+#endif
+
+/**
+ * Like lookup_batch but only stores whether each key is present.
+ */
+HT_FUNC_ATTR void P(contains_batch)(T* t, size_t n, K* keys, bool* out) {
+#ifdef HT_SMALL
+  if (SMALL(t)) {
+    for (size_t j = 0; j < n; j++)
+      out[j] = P(contains)(t, keys[j]);
+    return;
+  }
+#endif
+  uint h[HT_BATCH];
+  for (size_t b = 0; b < n; b += HT_BATCH) {
+    size_t m = ds_min(n - b, (size_t)HT_BATCH);
+    for (size_t j = 0; j < m; j++) {
+      h[j] = P(_hash)(keys[b + j]);
+      P(_prefetch)(t, h[j]);
+    }
+    for (size_t j = 0; j < m; j++)
+      out[b + j] = P(_contains_h)(t, keys[b + j], h[j]);
+  }
+}
+
+/**
+ * Inserts `n` key-value pairs with prefetching like lookup_batch. Keys that
+ * are already present are skipped. Returns the number of inserted pairs.
+ */
+#ifdef HT_SET
+HT_FUNC_ATTR size_t P(add_batch)(T* t, size_t n, K* keys) {
+#else
+HT_FUNC_ATTR size_t P(insert_batch)(T* t, size_t n, K* keys, V* vals) {
+#endif
+  uint h[HT_BATCH];
+  size_t inserted = 0;
+  size_t b = 0;
+#ifdef HT_SMALL
+  for (; b < n && SMALL(t); b++) // one by one until the table spills
+#  ifdef HT_SET
+    inserted += P(add)(t, keys[b]);
+#  else
+    inserted += P(insert)(t, keys[b], vals[b]);
+#  endif
+#endif
+  for (; b < n; b += HT_BATCH) {
+    size_t m = ds_min(n - b, (size_t)HT_BATCH);
+    for (size_t j = 0; j < m; j++) {
+      h[j] = P(_hash)(keys[b + j]);
+      P(_prefetch)(t, h[j]);
+    }
+    for (size_t j = 0; j < m; j++)
+      inserted += P(_insert_h)(t, keys[b + j], VAL(vals[b + j], ) h[j]);
+  }
+  return inserted;
+}
+
+/**
+ * Inits `t` with `n` key-value pairs. The table is sized once and, except
+ * with HT_COMPACT which keeps the order of `keys`, the pairs are first
+ * partitioned by their home slot so that the inserts sweep through the
+ * containers instead of jumping around. Of duplicate keys the first one is
+ * kept. Needs about `n` * (sizeof(K) + sizeof(V) + 8) bytes of scratch memory.
+ * Sets pass no `vals`.
+ */
+HT_FUNC_ATTR void P(build)(T* t, size_t n, K* keys VAL(, V* vals)) {
+  P(init)(t);
+  P(reserve)(t, n);
+#ifdef HT_SMALL
+  if (SMALL(t)) { // fits the inline slots
+#  ifdef HT_SET
+    P(add_batch)(t, n, keys);
+#  else
+    P(insert_batch)(t, n, keys, vals);
+#  endif
+    return;
+  }
+#endif
+#ifdef HT_COMPACT
+#  ifdef HT_SET
+  P(add_batch)(t, n, keys);
+#  else
+  P(insert_batch)(t, n, keys, vals);
+#  endif
+#else
+  // each part covers at least HT_BUILD_PART slots
+  size_t parts = ds_max(t->cap / HT_BUILD_PART, (size_t)1);
+  size_t shift = __builtin_ctzll(t->cap / parts);
+  uint* h = malloc(sizeof(uint) * n);
+  size_t* pos = calloc(parts + 1, sizeof(size_t));
+  for (size_t i = 0; i < n; i++) {
+    h[i] = P(_hash)(keys[i]);
+    pos[(P(_home)(t, h[i]) >> shift) + 1]++;
+  }
+  for (size_t p = 0; p < parts; p++)
+    pos[p + 1] += pos[p];
+  // stable scatter, so the first of duplicate keys is inserted first
+  struct P(_pair) {
+    K k;
+    VAL(V v);
+    uint h;
+  }* ps = ds_big_alloc(sizeof(*ps) * n);
+  for (size_t i = 0; i < n; i++) {
+    struct P(_pair)* q = &ps[pos[P(_home)(t, h[i]) >> shift]++];
+    memcpy(&q->k, &keys[i], sizeof(K));
+    VAL(q->v = vals[i]);
+    q->h = h[i];
+  }
+  for (size_t j = 0; j < n; j++)
+    P(_insert_h)(t, ps[j].k, VAL(ps[j].v, ) ps[j].h);
+  ds_big_free(ps, sizeof(*ps) * n);
+  free(pos);
+  free(h);
+#endif
+}
+
+#ifdef HT_WANT_SNAPSHOT
+// header of snapshot files, the containers follow at 64 byte aligned offsets
+struct P(_snap) {
+  u64 magic;
+  u64 mode; // layout switches, see _snap_mode
+  u64 seed; // HT_HASH_SEED
+  u64 cap;
+  u64 len;
+  u64 graves;
+  u64 used; // HT_COMPACT only
+  u32 key_size;
+  u32 val_size;
+};
+
+HT_FUNC_ATTR u64 P(_snap_mode)(void) {
+  u64 m = 0;
+#  ifdef HT_FAST_HASH
+  m |= 1;
+#  endif
+#  ifdef HT_CTRL
+  m |= 2;
+#  endif
+#  ifdef HT_ROBIN_HOOD
+  m |= 4;
+#  endif
+#  ifdef HT_CACHE_HASH
+  m |= 8;
+#  endif
+#  ifdef HT_COMPACT
+  m |= 16;
+#  endif
+#  ifdef HT_LAYOUT_INLINE
+  m |= 32;
+#  endif
+  return m;
+}
+
+/**
+ * Internal. Stores the file offsets and sizes of keys, values, control bytes,
+ * hashes and index (0 sized when not used) of a snapshot of `t` to `off` and
+ * `size` and returns the file size.
+ */
+HT_FUNC_ATTR size_t P(_snap_layout)(T* t, size_t* off, size_t* size) {
+  size[0] = sizeof(KS) * ECAP(t);
+  size[1] = 0;
+  VARR(size[1] = sizeof(V) * ECAP(t));
+  size[2] = size[3] = size[4] = 0;
+#  ifdef HT_CTRL
+  size[2] = t->cap;
+#  endif
+#  ifdef HASHES
+  size[3] = sizeof(uint) * ECAP(t);
+#  endif
+#  ifdef HT_COMPACT
+  size[4] = (size_t)t->cap << P(_ix_shift)(t->cap);
+#  endif
+  size_t pos = sizeof(struct P(_snap));
+  for (int i = 0; i < 5; i++) {
+    pos = (pos + 63) & ~(size_t)63;
+    off[i] = pos;
+    pos += size[i];
+  }
+  return pos;
+}
+
+/**
+ * Writes the table to the file at `path`. Returns false on IO errors.
+ */
+HT_FUNC_ATTR bool P(save)(T* t, const char* path) {
+#  ifdef HT_INCREMENTAL
+  if (t->okeys)
+    P(_migrate)(t, SIZE_MAX);
+#  endif
+  struct P(_snap) h = {
+      .magic = SNAP_MAGIC,
+      .mode = P(_snap_mode)(),
+      .seed = HT_HASH_SEED,
+      .cap = t->cap,
+      .len = t->len,
+      .graves = t->graves,
+      .key_size = sizeof(K),
+      .val_size = VAL_SIZE,
+  };
+  const void* data[5] = {t->keys};
+  VARR(data[1] = t->vals);
+#  ifdef HT_CTRL
+  data[2] = t->ctrl;
+#  endif
+#  ifdef HASHES
+  data[3] = t->hashes;
+#  endif
+#  ifdef HT_COMPACT
+  h.used = t->used;
+  data[4] = t->index;
+#  endif
+  size_t off[5], size[5];
+  P(_snap_layout)(t, off, size);
+  FILE* f = fopen(path, "wb");
+  if (!f)
+    return false;
+  static const byte zeros[64];
+  bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+  size_t pos = sizeof(h);
+  for (int i = 0; i < 5 && ok; i++) {
+    ok = fwrite(zeros, 1, off[i] - pos, f) == off[i] - pos &&
+         (!size[i] || fwrite(data[i], 1, size[i], f) == size[i]);
+    pos = off[i] + size[i];
+  }
+  return fclose(f) == 0 && ok;
+}
+
+/**
+ * Inits `t` from a file written by `save` without reading it: the containers
+ * point into a read-only mapping of the file, so only lookups, `next` and
+ * `deinit` may be used on the table. Returns false, leaving `t` alone, if
+ * the file can't be mapped, was saved by a table with a different layout or
+ * hash, or its header doesn't match its size. The slots themselves are
+ * trusted.
+ */
+HT_FUNC_ATTR bool P(load_mmap)(T* t, const char* path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  void* m = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(struct P(_snap)))
+    m = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (m == MAP_FAILED)
+    return false;
+  const struct P(_snap)* h = m;
+  T c; // only `cap`, to check the layout before `t` is touched
+  c.cap = h->cap;
+  size_t off[5], size[5];
+  // Every slot takes a byte at least, which also keeps the layout from
+  // overflowing, and a probe has to meet an empty slot.
+  bool ok = h->magic == SNAP_MAGIC && h->mode == P(_snap_mode)() &&
+            h->seed == HT_HASH_SEED && h->key_size == sizeof(K) &&
+            h->val_size == VAL_SIZE && h->cap >= MIN_CAP &&
+            !(h->cap & (h->cap - 1)) && c.cap == h->cap &&
+            h->cap <= (u64)st.st_size && h->len < h->cap &&
+            h->graves < h->cap - h->len &&
+            P(_snap_layout)(&c, off, size) == (size_t)st.st_size;
+#  ifdef HT_COMPACT
+  ok = ok && h->len <= h->used && h->used <= ECAP(&c);
+#  endif
+  if (!ok) {
+    munmap(m, st.st_size);
+    return false;
+  }
+  t->cap = h->cap;
+  t->len = h->len;
+  t->graves = h->graves;
+  t->keys = (KS*)((byte*)m + off[0]);
+  VARR(t->vals = (V*)((byte*)m + off[1]));
+#  ifdef HT_CTRL
+  t->ctrl = (u8*)m + off[2];
+#  endif
+#  ifdef HASHES
+  t->hashes = (uint*)((byte*)m + off[3]);
+#  endif
+#  ifdef HT_COMPACT
+  t->used = h->used;
+  t->index = (byte*)m + off[4];
+#  endif
+#  ifdef HT_INCREMENTAL
+  VARR(t->ovals = NULL);
+  t->okeys = NULL;
+#  endif
+  t->map = m;
+  t->map_len = st.st_size;
+#  ifdef HT_WANT_STATS
+  memset(&t->counters, 0, sizeof(t->counters));
+#  endif
+  // a different hash function with the same layout would find nothing
+  size_t it = 0;
+  K* k;
+  VAL(V* v);
+  if (P(next)(t, &it, &k VAL(, &v)) && !P(_contains_h)(t, *k, P(_hash)(*k))) {
+    P(deinit)(t);
+    return false;
+  }
+  return true;
+}
+#endif
+
+#ifdef HT_WANT_STATS
+/**
+ * Fills `s` with the counters and with the probe lengths and clustering of
+ * the table as it is now. Walks the whole table (and finishes a running
+ * incremental migration first).
+ */
+HT_FUNC_ATTR void P(stats)(T* t, struct P(stats)* s) {
+#  ifdef HT_INCREMENTAL
+  if (t->okeys)
+    P(_migrate)(t, SIZE_MAX);
+#  endif
+  memset(s, 0, sizeof(*s));
+  s->counters = t->counters;
+  s->len = t->len;
+  s->cap = t->cap;
+  s->graves = t->graves;
+#  ifdef HT_SMALL
+  if (SMALL(t)) // the inline slots aren't probed
+    return;
+#  endif
+  size_t mask = t->cap - 1;
+  size_t used = 0; // slots that aren't empty
+  u64 total = 0;
+  for (size_t i = 0; i < t->cap; i++) {
+    if (SLOT_EMPTY(t, i))
+      continue;
+    used++;
+    if (SLOT_GRAVE(t, i))
+      continue;
+#  ifdef HT_COMPACT
+    uint h = t->hashes[P(_ix_get)(t, i) - 2];
+#  elif defined(HASHES)
+    uint h = t->hashes[i];
+#  else
+    uint h = P(_hash)(SLOT_KEY(t, i));
+#  endif
+#  ifdef HT_CTRL
+    size_t d = ((i - P(_home)(t, h)) & mask) / GROUP;
+#  else
+    size_t d = (i - P(_home)(t, h)) & mask;
+#  endif
+    s->hist[ds_min(d, (size_t)HT_STATS_HIST - 1)]++;
+    s->max_dist = ds_max(s->max_dist, d);
+    total += d;
+  }
+  s->mean_dist = t->len ? (double)total / t->len : 0;
+#  ifndef HT_CTRL
+  // Knuth: a successful search probes (1 + 1 / (1 - load)) / 2 slots
+  double load = (double)used / t->cap;
+  s->expected_dist = load < 1 ? (1 / (1 - load) - 1) / 2 : 0;
+#  endif
+  // clusters, starting right after an empty slot so none is split in two
+  size_t start = 0;
+  while (start < t->cap && !SLOT_EMPTY(t, start))
+    start++;
+  size_t run = 0;
+  for (size_t j = 1; j <= t->cap; j++) {
+    size_t i = (start + j) & mask;
+    if (!SLOT_EMPTY(t, i)) {
+      run++;
+    } else if (run) {
+      s->clusters++;
+      s->max_cluster = ds_max(s->max_cluster, run);
+      run = 0;
+    }
+  }
+  if (run) { // no empty slot at all
+    s->clusters++;
+    s->max_cluster = run;
+  }
+  s->mean_cluster = s->clusters ? (double)used / s->clusters : 0;
+}
+#endif
+
+#undef P
+#undef T
 
 #undef K
 #undef V
+#undef VAL
+#undef VAL_SIZE
+#undef VARR
+#undef KS
+#undef KEY_AT
+#undef VAL_AT
+#undef SLOT_KEY
+#undef SLOT_VAL
+#undef HT_SET
 
 #undef IS_GRAVE
 #undef IS_EMPTY
+#undef HASHES
 #undef MAKE_GRAVE
 #undef MAKE_EMPTY
+#undef KEY_MOVE
+#undef SLOT_EMPTY
+#undef SLOT_GRAVE
+#undef MIN_CAP
+#undef ECAP
+
+#undef GROUP
+#undef CTRL_EMPTY
+#undef CTRL_GRAVE
+#undef CTRL_H1
+#undef CTRL_H2
+#undef HASH_EMPTY
+#undef HASH_GRAVE
+#undef IX_EMPTY
+#undef IX_GRAVE
 
+#undef HT_PREFIX
 #undef HT_KEY
 #undef HT_KEY_ATOMIC
 #undef HT_KEY_CUSTOM
@@ -348,10 +2161,39 @@ HT_FUNC_ATTR bool P(contains)(T* t, K k) {
 #undef HT_KEY_MEM
 #undef HT_KEY_STR
 #undef HT_KEY_STRPTR
+#undef HT_KEY_EQ
+#undef HT_KEY_HASH
+#undef HT_MULTIKEY
+#undef HT_MULTIKEY_NAMES
+#undef HT_BYVAL
 #undef HT_MAX_DENSITY
 #undef HT_MAX_GRAVE
+#undef HT_MIN_DENSITY
 #undef HT_VAL
 
 #undef HT_KEY_LEN
+#undef HT_FAST_HASH
+#undef HT_HASH_SEED
 
 #undef HT_WANT_PRINT
+#undef HT_WANT_SNAPSHOT
+#undef HT_WANT_STATS
+#undef HT_STATS_HIST
+#undef STAT
+#undef SNAP_MAGIC
+#undef HT_CTRL
+#undef HT_CACHE_HASH
+#undef HT_ROBIN_HOOD
+#undef HT_INCREMENTAL
+#undef HT_COMPACT
+#undef HT_LAYOUT_INLINE
+#undef HT_SMALL
+#undef HT_SIZE
+#undef SMALL
+#undef HT_MIGRATE_STEP
+#undef HT_BATCH
+#undef HT_BUILD_PART
+#undef HT_ALLOC
+#undef HT_FREE
+#undef HT_TABLE_EXTRA_VARS
+#undef HT_FUNC_ATTR
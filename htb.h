@@ -0,0 +1,554 @@
+#include "bigalloc.h"
+#include "common.h"
+#include "hash.h"
+
+#include <assert.h>
+#include <string.h>
+
+#ifndef ht_foreach
+// Loops over table `t` made with HT_PREFIX `prefix`, `k` and `v` point to the
+// key and value of each pair.
+#  define ht_foreach(prefix, t, k, v)                                          \
+    for (size_t _it = 0, _k = 1; _k; _k = 0)                                   \
+      for (ds_glue_expanded_(prefix, _k)* k; _k; _k = 0)                       \
+        for (ds_glue_expanded_(prefix, _v)* v;                                 \
+             ds_glue_expanded_(prefix, next)(t, &_it, &k, &v);)
+#endif
+
+/*
+ * # Bucketized cuckoo hashtable generator header
+ *
+ * ## Usage
+ *
+ * Same macros and functions as ht.h (without its modes), for tables that have
+ * to be dense: the default HT_MAX_DENSITY is 0.9 instead of 0.5, and a lookup
+ * still reads at most two buckets, the second one only when the key isn't in
+ * the first. That is at most two cache lines only when the tags, keys and
+ * values of a bucket fit in 64 bytes; bigger buckets span several lines each
+ * and the two-line bound does not hold for them.
+ *
+ * ## Internal workings
+ *
+ * Slots are grouped into buckets of HT_BUCKET slots. Every key has two
+ * candidate buckets and lives in one of them. Each slot has a one byte tag,
+ * 0 when the slot is empty and otherwise 8 bits of the key's hash, so `eq` is
+ * only called on slots whose tag matches.
+ *
+ * The first bucket comes from the low bits of the hash and the second one is
+ * the first XORed with a hash of the tag (partial-key cuckoo hashing), so the
+ * other bucket of a stored key is known from its bucket and tag alone.
+ *
+ * Insert takes a free slot in either bucket. When both are full, it evicts a
+ * random slot of the second bucket and moves the evicted key to its other
+ * bucket, evicting again if that one is full too, up to HT_MAX_KICKS times.
+ * If that doesn't free a slot, the table doubles. Removing just clears the
+ * tag, so there are no graves and HT_KEY_EMPTY and HT_KEY_GRAVE are not
+ * needed.
+ *
+ * Each value is kept in the bucket next to its tag and key. Buckets that fit
+ * in 64 bytes are padded to 64 and allocated on a 64 byte boundary, so each
+ * one is exactly one cache line. Bigger buckets are left unpadded.
+ *
+ * ## Required macros
+ *
+ * HT_PREFIX, HT_KEY, HT_VAL and one of HT_KEY_ATOMIC, HT_KEY_MEM,
+ * HT_KEY_EQ + HT_KEY_HASH or HT_KEY_CUSTOM like in ht.h.
+ *
+ * ### Switches
+ *
+ * HT_BUCKET - slots per bucket, 4 to 8 (default 4). Keep the tags, keys and
+ *             values of a bucket within 64 bytes, e.g. 7 slots of 4 byte keys
+ *             and values; 4 slots of 8 byte keys and values already take 72.
+ * HT_MAX_DENSITY - like in ht.h (default 0.9)
+ * HT_MIN_DENSITY - like in ht.h (default 0, never shrink)
+ * HT_MAX_KICKS - evictions before an insert gives up and grows the table
+ *             (default 500)
+ * HT_FAST_HASH, HT_HASH_SEED, HT_ALLOC, HT_FREE, HT_TABLE_EXTRA_VARS - like
+ *             in ht.h
+ *
+ * ### Functions
+ *
+ * Function | Description
+ * ---------|----
+ * init     | Init a table
+ * deinit   | Free memory used by a table
+ * alloc    | Alloc + init a table
+ * alloc_with | alloc that sets HT_TABLE_EXTRA_VARS before the first HT_ALLOC
+ * free     | Free memory used by a table and the table itself
+ *
+ * lookup   | Try to find a value under a key.
+ * contains | Is the key present.
+ * insert   | Try to insert a new key-value pair.
+ * update   | Update value under a key. Create key if needed.
+ * remove   | Delete a key-value pair if it exists and return the value.
+ * next     | Cursor over all pairs, see also `ht_foreach`.
+ * reserve  | Make room for a number of elements up front
+ */
+
+#ifndef HT_KEY
+#  error You have to define HT_KEY
+#endif
+
+#ifndef HT_VAL
+#  error You have to define HT_VAL
+#endif
+
+#ifndef HT_BUCKET
+// Slots per bucket
+#  define HT_BUCKET 4
+#endif
+
+#if HT_BUCKET < 4 || HT_BUCKET > 8
+#  error HT_BUCKET has to be between 4 and 8
+#endif
+
+#ifndef HT_MAX_DENSITY
+// Maximum elements/slots ratio
+#  define HT_MAX_DENSITY 0.9
+#endif
+
+#ifndef HT_MIN_DENSITY
+// Elements/slots ratio below which remove shrinks the table. Off by default,
+// e.g. 0.125 saves memory after mass removals but makes tables that empty out
+// and fill again regularly rehash twice per cycle.
+#  define HT_MIN_DENSITY 0
+#endif
+
+#ifndef HT_MAX_KICKS
+// Evictions tried by an insert before the table grows
+#  define HT_MAX_KICKS 500
+#endif
+
+#ifndef HT_HASH_SEED
+// Seed of HT_FAST_HASH
+#  define HT_HASH_SEED 0
+#endif
+
+#ifndef HT_ALLOC
+// Allocates memory for the containers of table `t`
+#  define HT_ALLOC(t, size) ds_big_alloc(size)
+#endif
+
+#ifndef HT_FREE
+// Frees containers of table `t` allocated by HT_ALLOC
+#  define HT_FREE(t, ptr, size) ds_big_free(ptr, size)
+#endif
+
+#ifndef HT_FUNC_ATTR
+#  define HT_FUNC_ATTR
+#endif
+
+#define P(x) ds_glue_expanded_(HT_PREFIX, x)
+
+// shortcuts
+#define K HT_KEY
+#define V HT_VAL
+
+#define MIN_CAP 4           // buckets
+#define CACHE_LINE 64
+#define ALT_MUL 0x5bd1e995u // spreads tags over the bucket index bits
+
+#define T struct P(table)
+#define B struct P(bucket)
+
+typedef K P(_k); // for ht_foreach
+typedef V P(_v);
+
+// A bucket without padding, to tell whether it fits in a cache line
+struct P(_slots) {
+  u8 tags[HT_BUCKET];
+  K keys[HT_BUCKET];
+  V vals[HT_BUCKET];
+};
+
+#define BUCKET_ALIGN                                                           \
+  (sizeof(struct P(_slots)) <= CACHE_LINE ? CACHE_LINE                         \
+                                          : _Alignof(struct P(_slots)))
+
+struct P(bucket) {
+  // 0 for empty slots, otherwise _tag of the key
+  _Alignas(BUCKET_ALIGN) u8 tags[HT_BUCKET];
+  K keys[HT_BUCKET];
+  V vals[HT_BUCKET];
+};
+_Static_assert(sizeof(B) >= 8, "_match reads 8 bytes");
+
+struct P(table) {
+  size_t len; // number of elements in table
+  size_t cap; // number of buckets, power of two
+  B* buckets; // BUCKET_ALIGN aligned, inside mem
+  void* mem;  // block from HT_ALLOC
+  u32 pad;    // bytes mem was allocated with beyond the buckets
+  u32 rng;    // picks the slots to evict
+#ifdef HT_TABLE_EXTRA_VARS
+  HT_TABLE_EXTRA_VARS
+#endif
+};
+
+#ifndef HT_KEY_CUSTOM
+HT_FUNC_ATTR uint P(hash)(K key) {
+#  ifdef HT_KEY_ATOMIC
+  return ((sizeof(key) <= 4) ? ds_hash_u32(key) : ds_hash_u64(key));
+#  elif defined(HT_KEY_MEM) && defined(HT_FAST_HASH)
+  u64 h = ds_hash_wy(key, HT_KEY_LEN, HT_HASH_SEED);
+  return (uint)h ^ (uint)(h >> 32);
+#  elif defined(HT_KEY_MEM)
+  return ds_hash_mem(HT_KEY_LEN, key);
+#  elif defined(HT_KEY_HASH)
+  return HT_KEY_HASH(key);
+#  else
+#    error Unable to determin which hash function to generate
+#  endif
+}
+
+HT_FUNC_ATTR bool P(eq)(K a, K b) {
+#  ifdef HT_KEY_ATOMIC
+  return a == b;
+#  elif defined(HT_KEY_MEM)
+  return memcmp(a, b, HT_KEY_LEN) == 0;
+#  elif defined(HT_KEY_EQ)
+  return HT_KEY_EQ(a, b);
+#  else
+#    error Unable to determin which hash function to generate
+#  endif
+}
+#endif // ifndef HT_KEY_CUSTOM
+
+/**
+ * Internal. The hash used for bucket selection.
+ */
+HT_FUNC_ATTR uint P(_hash)(K k) { return ds_hash_mix(P(hash)(k)); }
+
+/**
+ * Internal. Tag of a key with hash `h`, taken from the bits above the bucket
+ * index.
+ */
+HT_FUNC_ATTR u8 P(_tag)(uint h) {
+  u8 tag = h >> 24;
+  return tag ? tag : 1;
+}
+
+/**
+ * Internal. The other bucket of a key with tag `tag` that is in bucket `i`.
+ * The lowest bit is always flipped, so the two buckets always differ.
+ */
+HT_FUNC_ATTR size_t P(_alt)(T* t, size_t i, u8 tag) {
+  return (i ^ ((tag * ALT_MUL) | 1)) & (t->cap - 1);
+}
+
+HT_FUNC_ATTR void P(_alloc_buckets)(T* t) {
+  size_t size = sizeof(B) * t->cap;
+  t->mem = HT_ALLOC(t, size);
+  t->pad = 0;
+  if ((uintptr_t)t->mem % BUCKET_ALIGN) {
+    // Big blocks come page aligned, only retry with room to align the rest
+    HT_FREE(t, t->mem, size);
+    t->pad = BUCKET_ALIGN - 1;
+    t->mem = HT_ALLOC(t, size + t->pad);
+  }
+  uintptr_t p = (uintptr_t)t->mem + t->pad;
+  t->buckets = (B*)(p - p % BUCKET_ALIGN);
+  for (size_t i = 0; i < t->cap; i++)
+    memset(t->buckets[i].tags, 0, HT_BUCKET);
+}
+
+HT_FUNC_ATTR void P(_free_buckets)(T* t) {
+  HT_FREE(t, t->mem, sizeof(B) * t->cap + t->pad);
+}
+
+HT_FUNC_ATTR void P(init)(T* t) {
+  t->len = 0;
+  t->cap = MIN_CAP;
+  t->rng = 1;
+  P(_alloc_buckets)(t);
+}
+
+HT_FUNC_ATTR void P(deinit)(T* t) { P(_free_buckets)(t); }
+
+HT_FUNC_ATTR T* P(alloc)(void) {
+  T* t = calloc(1, sizeof(T)); // HT_TABLE_EXTRA_VARS start out zero
+  P(init)(t);
+  return t;
+}
+
+#ifdef HT_TABLE_EXTRA_VARS
+/**
+ * Allocs a table, copies `extra` into it and inits it, so HT_ALLOC can use the
+ * HT_TABLE_EXTRA_VARS set in `extra`. Its other fields are ignored.
+ */
+HT_FUNC_ATTR T* P(alloc_with)(const T* extra) {
+  T* t = malloc(sizeof(T));
+  *t = *extra;
+  P(init)(t);
+  return t;
+}
+#endif
+
+HT_FUNC_ATTR void P(free)(T* t) {
+  P(deinit)(t);
+  free(t);
+}
+
+/**
+ * Internal. Bitmask with bit 8 * j set for every slot j of bucket `b` whose tag
+ * is `tag`. Compares all tags at once, the bucket is at least 8 bytes big.
+ */
+HT_FUNC_ATTR u64 P(_match)(B* b, u8 tag) {
+  u64 x;
+  memcpy(&x, b, 8);
+  x ^= tag * 0x0101010101010101ull; // matching tags become zero bytes
+  u64 l = 0x7f7f7f7f7f7f7f7full;
+  u64 m = ~(((x & l) + l) | x | l) >> 7; // 1 in the lowest bit of zero bytes
+#if HT_BUCKET < 8
+  m &= (1ull << (8 * HT_BUCKET)) - 1;
+#endif
+  return m;
+}
+
+/**
+ * Internal. Slot (bucket * HT_BUCKET + slot) of key `k` with hash `h` or
+ * SIZE_MAX if it's not present.
+ */
+HT_FUNC_ATTR size_t P(_find)(T* t, K k, uint h) {
+  u8 tag = P(_tag)(h);
+  size_t i = h & (t->cap - 1);
+  for (int n = 0; n < 2; n++, i = P(_alt)(t, i, tag)) {
+    B* b = &t->buckets[i];
+    for (u64 m = P(_match)(b, tag); m; m &= m - 1) {
+      uint j = __builtin_ctzll(m) >> 3;
+      if (P(eq)(b->keys[j], k))
+        return i * HT_BUCKET + j;
+    }
+  }
+  return SIZE_MAX;
+}
+
+/**
+ * Internal. Stores the pair into a free slot of bucket `i` if it has one.
+ */
+HT_FUNC_ATTR bool P(_put)(T* t, size_t i, u8 tag, K k, V v) {
+  B* b = &t->buckets[i];
+  for (uint j = 0; j < HT_BUCKET; j++) {
+    if (!b->tags[j]) {
+      b->tags[j] = tag;
+      b->keys[j] = k;
+      b->vals[j] = v;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Internal. Places the new pair `*k`, `*v` with hash `h`, evicting other keys
+ * if both of its buckets are full. Returns false if HT_MAX_KICKS evictions
+ * weren't enough, `*k` and `*v` are then the evicted pair that is left
+ * without a slot.
+ */
+HT_FUNC_ATTR bool P(_place)(T* t, K* k, V* v, uint h) {
+  u8 tag = P(_tag)(h);
+  size_t i = h & (t->cap - 1);
+  if (P(_put)(t, i, tag, *k, *v))
+    return true;
+  i = P(_alt)(t, i, tag);
+  if (P(_put)(t, i, tag, *k, *v))
+    return true;
+  for (int n = 0; n < HT_MAX_KICKS; n++) {
+    // xorshift32, the victim has to be random or evictions can cycle
+    t->rng ^= t->rng << 13;
+    t->rng ^= t->rng >> 17;
+    t->rng ^= t->rng << 5;
+    uint j = t->rng % HT_BUCKET;
+    B* b = &t->buckets[i];
+    u8 et = b->tags[j];
+    K ek = b->keys[j];
+    V ev = b->vals[j];
+    b->tags[j] = tag;
+    b->keys[j] = *k;
+    b->vals[j] = *v;
+    tag = et;
+    *k = ek;
+    *v = ev;
+    i = P(_alt)(t, i, tag);
+    if (P(_put)(t, i, tag, *k, *v))
+      return true;
+  }
+  return false;
+}
+
+/**
+ * Rehashes the table into `cap` buckets, or more if the keys don't fit.
+ */
+HT_FUNC_ATTR void P(_resize)(T* t, size_t cap) {
+  for (;; cap *= 2) {
+    T n = *t; // keeps HT_TABLE_EXTRA_VARS for the allocator
+    n.cap = cap;
+    P(_alloc_buckets)(&n);
+    size_t i = 0;
+    for (; i < t->cap * HT_BUCKET; i++) {
+      if (!t->buckets[i / HT_BUCKET].tags[i % HT_BUCKET])
+        continue;
+      K k = t->buckets[i / HT_BUCKET].keys[i % HT_BUCKET];
+      V v = t->buckets[i / HT_BUCKET].vals[i % HT_BUCKET];
+      if (!P(_place)(&n, &k, &v, P(_hash)(k)))
+        break;
+    }
+    if (i == t->cap * HT_BUCKET) {
+      P(_free_buckets)(t);
+      t->cap = n.cap;
+      t->buckets = n.buckets;
+      t->mem = n.mem;
+      t->pad = n.pad;
+      t->rng = n.rng;
+      return;
+    }
+    P(_free_buckets)(&n); // the old buckets still have everything
+  }
+}
+
+/**
+ * Internal. Smallest number of buckets that holds `n` elements.
+ */
+HT_FUNC_ATTR size_t P(_cap_for)(size_t n) {
+  size_t cap = MIN_CAP;
+  while (n > HT_MAX_DENSITY * cap * HT_BUCKET)
+    cap *= 2;
+  return cap;
+}
+
+/**
+ * Grows the table so that it holds `n` elements at HT_MAX_DENSITY.
+ */
+HT_FUNC_ATTR void P(reserve)(T* t, size_t n) {
+  size_t cap = P(_cap_for)(n);
+  if (cap > t->cap)
+    P(_resize)(t, cap);
+}
+
+/**
+ * Internal. Adds a pair whose key is not present.
+ */
+HT_FUNC_ATTR void P(_add)(T* t, K k, V v, uint h) {
+  if (t->len + 1 > HT_MAX_DENSITY * t->cap * HT_BUCKET)
+    P(_resize)(t, t->cap * 2);
+  while (!P(_place)(t, &k, &v, h)) { // too crowded before the usual density
+    P(_resize)(t, t->cap * 2);
+    h = P(_hash)(k);
+  }
+  t->len++;
+}
+
+/**
+ * Internal. Value of slot `i` from _find.
+ */
+HT_FUNC_ATTR V* P(_val)(T* t, size_t i) {
+  return &t->buckets[i / HT_BUCKET].vals[i % HT_BUCKET];
+}
+
+/**
+ * Finds a value with given key and returns a pointer to it. Returns NULL if the
+ * key is not present
+ */
+HT_FUNC_ATTR V* P(lookup)(T* t, K k) {
+  size_t i = P(_find)(t, k, P(_hash)(k));
+  return i == SIZE_MAX ? NULL : P(_val)(t, i);
+}
+
+HT_FUNC_ATTR bool P(contains)(T* t, K k) {
+  return P(_find)(t, k, P(_hash)(k)) != SIZE_MAX;
+}
+
+/**
+ * Inserts a new key-value pair. If the key is already present returns false.
+ * Otherwise returns true
+ */
+HT_FUNC_ATTR bool P(insert)(T* t, K k, V v) {
+  uint h = P(_hash)(k);
+  if (P(_find)(t, k, h) != SIZE_MAX)
+    return false;
+  P(_add)(t, k, v, h);
+  return true;
+}
+
+/**
+ * Updates the value behind the given key.
+ * Inserts a new key-value pair if needed.
+ */
+HT_FUNC_ATTR void P(update)(T* t, K k, V v) {
+  uint h = P(_hash)(k);
+  size_t i = P(_find)(t, k, h);
+  if (i != SIZE_MAX)
+    *P(_val)(t, i) = v;
+  else
+    P(_add)(t, k, v, h);
+}
+
+/**
+ * Removes a key.
+ */
+HT_FUNC_ATTR V P(remove)(T* t, K k, bool* b) {
+  size_t i = P(_find)(t, k, P(_hash)(k));
+  if (i == SIZE_MAX) {
+    *b = false;
+    return (V){0};
+  }
+  V v = *P(_val)(t, i);
+  t->buckets[i / HT_BUCKET].tags[i % HT_BUCKET] = 0;
+  t->len--;
+  *b = true;
+  // shrink, leaving room for as many inserts as there are elements
+  if (t->cap > MIN_CAP && t->len < HT_MIN_DENSITY * t->cap * HT_BUCKET)
+    P(_resize)(t, P(_cap_for)(2 * t->len));
+  return v;
+}
+
+/**
+ * Cursor over all key-value pairs. Start with `*it` = 0, each call points `k`
+ * and `v` at the next pair and returns false once there are no more. The
+ * table must not be modified while iterating, except for the values.
+ */
+HT_FUNC_ATTR bool P(next)(T* t, size_t* it, K** k, V** v) {
+  for (size_t i = *it; i < t->cap * HT_BUCKET; i++) {
+    B* b = &t->buckets[i / HT_BUCKET];
+    if (b->tags[i % HT_BUCKET]) {
+      *it = i + 1;
+      *k = &b->keys[i % HT_BUCKET];
+      *v = &b->vals[i % HT_BUCKET];
+      return true;
+    }
+  }
+  return false;
+}
+
+#undef P
+#undef T
+#undef B
+
+#undef K
+#undef V
+
+#undef MIN_CAP
+#undef ALT_MUL
+#undef CACHE_LINE
+#undef BUCKET_ALIGN
+
+#undef HT_PREFIX
+#undef HT_KEY
+#undef HT_KEY_ATOMIC
+#undef HT_KEY_CUSTOM
+#undef HT_KEY_MEM
+#undef HT_KEY_EQ
+#undef HT_KEY_HASH
+#undef HT_MAX_DENSITY
+#undef HT_MIN_DENSITY
+#undef HT_MAX_KICKS
+#undef HT_VAL
+#undef HT_BUCKET
+
+#undef HT_KEY_LEN
+#undef HT_FAST_HASH
+#undef HT_HASH_SEED
+#undef HT_ALLOC
+#undef HT_FREE
+#undef HT_TABLE_EXTRA_VARS
+#undef HT_FUNC_ATTR
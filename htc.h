@@ -0,0 +1,492 @@
+#include "common.h"
+#include "hash.h"
+
+#include <assert.h>
+#include <string.h>
+
+/*
+ * # Concurrent hashtable generator header
+ *
+ * ## Usage
+ *
+ * Same macros as ht.h, so a table converts by including htc.h instead.
+ * All functions may be called from any number of threads at once.
+ *
+ * Values can't be handed out by pointer because a concurrent writer could
+ * move them, so `lookup` copies the value out and `remove` returns it.
+ *
+ * ## Internal workings
+ *
+ * The table is split into HT_SHARDS independent open adressing tables with
+ * linear probing, picked by the top bits of the hash. Every shard is guarded by
+ * a sequence counter:
+ *
+ *  - writers take the shard by making the counter odd (spinning on CAS) and
+ *    release it by making it even again, so writers to different shards never
+ *    touch the same cache line
+ *  - readers don't write anything; they read the counter, probe, and retry if
+ *    the counter changed or was odd in the meantime
+ *
+ * Keys and values that readers probe are only accessed with atomics, release
+ * stores by the writer and acquire loads by the readers, one word at a time.
+ * The race is intended, that makes it defined behaviour and keeps the table
+ * clean under ThreadSanitizer, and the orderings take the place of fences: a
+ * reader that sees a store also sees the odd counter before it, and its loads
+ * stay before its second read of the counter. On x86 both are plain moves.
+ *
+ * Growing a shard allocates a new slot block and publishes it while the other
+ * shards keep going, so a resize only stalls 1/HT_SHARDS of the table. Old
+ * blocks may still be read by a reader that is about to retry, so they are
+ * freed in deinit (growth is geometric, so that's at most one extra table).
+ * Graves are cleared in place.
+ *
+ * ## Required macros
+ *
+ * HT_PREFIX, HT_KEY, HT_VAL, HT_KEY_EMPTY, HT_KEY_GRAVE and one of HT_KEY_ATOMIC,
+ * HT_KEY_MEM, HT_KEY_EQ + HT_KEY_HASH or HT_KEY_CUSTOM like in ht.h.
+ *
+ * ### Switches
+ *
+ * HT_SHARDS - number of shards, power of two (default 64)
+ * HT_FAST_HASH, HT_HASH_SEED - like in ht.h
+ *
+ * ### Functions
+ *
+ * Function | Description
+ * ---------|----
+ * init     | Init a table
+ * deinit   | Free memory used by a table
+ * alloc    | Alloc + init a table
+ * free     | Free memory used by a table and the table itself
+ *
+ * lookup   | Copy the value under a key to `out`. Returns false if not found.
+ * contains | Is the key present.
+ * insert   | Try to insert a new key-value pair.
+ * update   | Update value under a key. Create key if needed.
+ * remove   | Delete a key-value pair if it exists and return the value.
+ * len      | Number of elements. Exact only if no writer is running.
+ */
+
+#ifndef HT_KEY
+#  error You have to define HT_KEY
+#endif
+
+#ifndef HT_VAL
+#  error You have to define HT_VAL
+#endif
+
+#ifndef HT_KEY_EMPTY
+#  error You have to define special empty key value
+#endif
+
+#ifndef HT_KEY_GRAVE
+#  error You have to define special grave key value
+#endif
+
+#ifndef HT_MAX_DENSITY
+// Maximum elements/capacity ratio
+#  define HT_MAX_DENSITY 0.5
+#endif
+
+#ifndef HT_MAX_GRAVE
+// Maximum ratio graves/capacity ratio
+#  define HT_MAX_GRAVE 0.25
+#endif
+
+#ifndef HT_SHARDS
+#  define HT_SHARDS 64
+#endif
+
+#ifndef HT_HASH_SEED
+// Seed of HT_FAST_HASH
+#  define HT_HASH_SEED 0
+#endif
+
+#ifndef HT_FUNC_ATTR
+#  define HT_FUNC_ATTR
+#endif
+
+#define P(x) ds_glue_expanded_(HT_PREFIX, x)
+
+// shortcuts
+#define K HT_KEY
+#define V HT_VAL
+#define IS_GRAVE(x) P(eq)(HT_KEY_GRAVE, x)
+#define IS_EMPTY(x) P(eq)(HT_KEY_EMPTY, x)
+
+#define MAKE_EMPTY(x) x = HT_KEY_EMPTY
+
+#define SHARD_BITS __builtin_ctz(HT_SHARDS)
+#define MIN_CAP 8
+
+#if defined(__x86_64__) || defined(__i386__)
+#  define RELAX() __builtin_ia32_pause()
+#else
+#  define RELAX() ((void)0)
+#endif
+
+#define T struct P(table)
+#define S struct P(shard)
+#define B struct P(block)
+
+// Keys and values of one shard behind a single pointer, so that a reader always
+// sees a capacity matching the arrays.
+struct P(block) {
+  size_t cap;
+  V* vals;
+  B* retired; // previous blocks, freed in deinit
+  K keys[];
+};
+
+struct P(shard) {
+  u32 seq;       // odd while a writer is modifying the shard
+  size_t len;    // number of elements in the shard
+  size_t graves; // number of graves in the shard
+  B* block;
+} __attribute__((aligned(64)));
+
+struct P(table) {
+  S shards[HT_SHARDS];
+#ifdef HT_TABLE_EXTRA_VARS
+  HT_TABLE_EXTRA_VARS
+#endif
+};
+
+#ifndef HT_KEY_CUSTOM
+HT_FUNC_ATTR uint P(hash)(K key) {
+#  ifdef HT_KEY_ATOMIC
+  return ((sizeof(key) <= 4) ? ds_hash_u32(key) : ds_hash_u64(key));
+#  elif defined(HT_KEY_MEM) && defined(HT_FAST_HASH)
+  u64 h = ds_hash_wy(key, HT_KEY_LEN, HT_HASH_SEED);
+  return (uint)h ^ (uint)(h >> 32);
+#  elif defined(HT_KEY_MEM)
+  return ds_hash_mem(HT_KEY_LEN, key);
+#  elif defined(HT_KEY_HASH)
+  return HT_KEY_HASH(key);
+#  else
+#    error Unable to determin which hash function to generate
+#  endif
+}
+
+HT_FUNC_ATTR bool P(eq)(K a, K b) {
+#  ifdef HT_KEY_ATOMIC
+  return a == b;
+#  elif defined(HT_KEY_MEM)
+  return memcmp(a, b, HT_KEY_LEN) == 0;
+#  elif defined(HT_KEY_EQ)
+  return HT_KEY_EQ(a, b);
+#  else
+#    error Unable to determin which hash function to generate
+#  endif
+}
+#endif // ifndef HT_KEY_CUSTOM
+
+/**
+ * Internal. The hash used for shard and slot selection.
+ */
+HT_FUNC_ATTR uint P(_hash)(K k) { return ds_hash_mix(P(hash)(k)); }
+
+HT_FUNC_ATTR S* P(_shard)(T* t, uint h) {
+  return &t->shards[(h >> (31 - SHARD_BITS)) >> 1]; // shift by 32 if 1 shard
+}
+
+/**
+ * Internal. Copies `size` bytes aligned to `align` from the slots of a
+ * published block to `dst`, see "Internal workings".
+ */
+HT_FUNC_ATTR void P(_load)(void* dst, const void* src, size_t size,
+                           size_t align) {
+  if (align % 8 == 0 && size % 8 == 0)
+    for (size_t i = 0; i < size / 8; i++)
+      ((u64*)dst)[i] = __atomic_load_n((u64*)src + i, __ATOMIC_ACQUIRE);
+  else if (align % 4 == 0 && size % 4 == 0)
+    for (size_t i = 0; i < size / 4; i++)
+      ((u32*)dst)[i] = __atomic_load_n((u32*)src + i, __ATOMIC_ACQUIRE);
+  else
+    for (size_t i = 0; i < size; i++)
+      ((u8*)dst)[i] = __atomic_load_n((u8*)src + i, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Internal. Copies `size` bytes aligned to `align` from `src` to the slots of
+ * a published block.
+ */
+HT_FUNC_ATTR void P(_store)(void* dst, const void* src, size_t size,
+                            size_t align) {
+  if (align % 8 == 0 && size % 8 == 0)
+    for (size_t i = 0; i < size / 8; i++)
+      __atomic_store_n((u64*)dst + i, ((u64*)src)[i], __ATOMIC_RELEASE);
+  else if (align % 4 == 0 && size % 4 == 0)
+    for (size_t i = 0; i < size / 4; i++)
+      __atomic_store_n((u32*)dst + i, ((u32*)src)[i], __ATOMIC_RELEASE);
+  else
+    for (size_t i = 0; i < size; i++)
+      __atomic_store_n((u8*)dst + i, ((u8*)src)[i], __ATOMIC_RELEASE);
+}
+
+#define LOAD(dst, src) P(_load)(&(dst), &(src), sizeof(dst), __alignof__(dst))
+#define STORE(dst, src) P(_store)(&(dst), &(src), sizeof(dst), __alignof__(dst))
+
+HT_FUNC_ATTR B* P(_block_alloc)(size_t cap) {
+  B* b = malloc(sizeof(B) + sizeof(K) * cap);
+  b->cap = cap;
+  b->vals = malloc(sizeof(V) * cap);
+  b->retired = NULL;
+  for (size_t i = 0; i < cap; i++)
+    MAKE_EMPTY(b->keys[i]);
+  return b;
+}
+
+HT_FUNC_ATTR void P(_block_free)(B* b) {
+  while (b) {
+    B* r = b->retired;
+    free(b->vals);
+    free(b);
+    b = r;
+  }
+}
+
+HT_FUNC_ATTR void P(init)(T* t) {
+  for (size_t i = 0; i < HT_SHARDS; i++) {
+    S* s = &t->shards[i];
+    s->seq = 0;
+    s->len = 0;
+    s->graves = 0;
+    s->block = P(_block_alloc)(MIN_CAP);
+  }
+}
+
+HT_FUNC_ATTR void P(deinit)(T* t) {
+  for (size_t i = 0; i < HT_SHARDS; i++)
+    P(_block_free)(t->shards[i].block);
+}
+
+HT_FUNC_ATTR T* P(alloc)(void) {
+  T* t = aligned_alloc(64, sizeof(T));
+  P(init)(t);
+  return t;
+}
+
+HT_FUNC_ATTR void P(free)(T* t) {
+  P(deinit)(t);
+  free(t);
+}
+
+/**
+ * Internal. Takes the shard for writing.
+ */
+HT_FUNC_ATTR void P(_lock)(S* s) {
+  for (;;) {
+    u32 q = __atomic_load_n(&s->seq, __ATOMIC_RELAXED);
+    if (!(q & 1) && __atomic_compare_exchange_n(&s->seq, &q, q + 1, true,
+                                                __ATOMIC_ACQUIRE,
+                                                __ATOMIC_RELAXED))
+      break;
+    RELAX();
+  }
+}
+
+HT_FUNC_ATTR void P(_unlock)(S* s) {
+  u32 q = __atomic_load_n(&s->seq, __ATOMIC_RELAXED);
+  __atomic_store_n(&s->seq, q + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Internal. Looks up the given key with hash `h` in block `b` and returns its
+ * index. If the key is not present, sets `new` and returns the index where it
+ * should be inserted. Gives up after `cap` slots so that a reader probing a
+ * block that is being modified can't loop forever.
+ */
+HT_FUNC_ATTR size_t P(_get_key_index)(B* b, K k, uint h, bool* new) {
+  size_t mask = b->cap - 1;
+  size_t i = h & mask;
+  for (size_t n = 0; n < b->cap; n++, i = (i + 1) & mask) {
+    K c;
+    LOAD(c, b->keys[i]);
+    if (IS_EMPTY(c)) {
+      *new = true;
+      return i;
+    } else if (!IS_GRAVE(c) && P(eq)(c, k))
+      return i;
+  }
+  *new = true;
+  return SIZE_MAX;
+}
+
+/**
+ * Internal. Rehashes all keys of `ob` into `b`.
+ */
+HT_FUNC_ATTR void P(_move)(B* b, B* ob) {
+  size_t mask = b->cap - 1;
+  for (size_t i = 0; i < ob->cap; i++) {
+    K k = ob->keys[i];
+    if (IS_EMPTY(k) || IS_GRAVE(k))
+      continue;
+    size_t j = P(_hash)(k) & mask;
+    while (!IS_EMPTY(b->keys[j])) // walk until we find empty slot
+      j = (j + 1) & mask;
+    b->keys[j] = k;
+    b->vals[j] = ob->vals[i];
+  }
+}
+
+/**
+ * Internal. Grows the shard or clears its graves if needed. Called with the
+ * shard locked.
+ */
+HT_FUNC_ATTR void P(_maybe_rehash)(S* s) {
+  B* ob = s->block;
+  if (s->len + s->graves > HT_MAX_DENSITY * ob->cap ||
+      s->graves > HT_MAX_GRAVE * ob->cap) {
+    size_t cap = ob->cap;
+    while (s->len > HT_MAX_DENSITY * cap)
+      cap *= 2;
+    B* b = P(_block_alloc)(cap);
+    P(_move)(b, ob);
+    if (cap == ob->cap) { // only graves, clear them in place
+      P(_store)(ob->keys, b->keys, sizeof(K) * cap, _Alignof(K));
+      P(_store)(ob->vals, b->vals, sizeof(V) * cap, _Alignof(V));
+      P(_block_free)(b);
+    } else {
+      b->retired = ob;
+      __atomic_store_n(&s->block, b, __ATOMIC_RELEASE);
+    }
+    s->graves = 0;
+  }
+}
+
+/**
+ * Copies the value under the given key to `out`. Returns false if the key is
+ * not present. Never blocks writers.
+ */
+HT_FUNC_ATTR bool P(lookup)(T* t, K k, V* out) {
+  uint h = P(_hash)(k);
+  S* s = P(_shard)(t, h);
+  for (;;) {
+    u32 q = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+    if (q & 1) {
+      RELAX();
+      continue;
+    }
+    B* b = __atomic_load_n(&s->block, __ATOMIC_ACQUIRE);
+    bool new = false;
+    size_t i = P(_get_key_index)(b, k, h, &new);
+    if (!new)
+      LOAD(*out, b->vals[i]);
+    if (__atomic_load_n(&s->seq, __ATOMIC_RELAXED) == q)
+      return !new;
+  }
+}
+
+HT_FUNC_ATTR bool P(contains)(T* t, K k) {
+  V v;
+  return P(lookup)(t, k, &v);
+}
+
+/**
+ * Inserts a new key-value pair. If the key is already present returns false.
+ * Otherwise returns true
+ */
+HT_FUNC_ATTR bool P(insert)(T* t, K k, V v) {
+  uint h = P(_hash)(k);
+  S* s = P(_shard)(t, h);
+  bool new = false;
+  P(_lock)(s);
+  size_t i = P(_get_key_index)(s->block, k, h, &new);
+  if (new) {
+    STORE(s->block->keys[i], k);
+    STORE(s->block->vals[i], v);
+    __atomic_store_n(&s->len, s->len + 1, __ATOMIC_RELAXED);
+    P(_maybe_rehash)(s);
+  }
+  P(_unlock)(s);
+  return new;
+}
+
+/**
+ * Updates the value behind the given key.
+ * Inserts a new key-value pair if needed.
+ */
+HT_FUNC_ATTR void P(update)(T* t, K k, V v) {
+  uint h = P(_hash)(k);
+  S* s = P(_shard)(t, h);
+  bool new = false;
+  P(_lock)(s);
+  size_t i = P(_get_key_index)(s->block, k, h, &new);
+  STORE(s->block->keys[i], k);
+  STORE(s->block->vals[i], v);
+  if (new) {
+    __atomic_store_n(&s->len, s->len + 1, __ATOMIC_RELAXED);
+    P(_maybe_rehash)(s);
+  }
+  P(_unlock)(s);
+}
+
+/**
+ * Removes a key.
+ */
+HT_FUNC_ATTR V P(remove)(T* t, K k, bool* found) {
+  uint h = P(_hash)(k);
+  S* s = P(_shard)(t, h);
+  bool new = false;
+  V v = {0};
+  P(_lock)(s);
+  size_t i = P(_get_key_index)(s->block, k, h, &new);
+  if (!new) {
+    v = s->block->vals[i];
+    K g = HT_KEY_GRAVE;
+    STORE(s->block->keys[i], g);
+    __atomic_store_n(&s->len, s->len - 1, __ATOMIC_RELAXED);
+    s->graves++;
+    P(_maybe_rehash)(s);
+  }
+  P(_unlock)(s);
+  *found = !new;
+  return v;
+}
+
+HT_FUNC_ATTR size_t P(len)(T* t) {
+  size_t len = 0;
+  for (size_t i = 0; i < HT_SHARDS; i++)
+    len += __atomic_load_n(&t->shards[i].len, __ATOMIC_RELAXED);
+  return len;
+}
+
+#undef P
+#undef T
+#undef S
+#undef B
+
+#undef K
+#undef V
+
+#undef IS_GRAVE
+#undef IS_EMPTY
+#undef MAKE_EMPTY
+#undef LOAD
+#undef STORE
+#undef SHARD_BITS
+#undef MIN_CAP
+#undef RELAX
+
+#undef HT_PREFIX
+#undef HT_KEY
+#undef HT_KEY_ATOMIC
+#undef HT_KEY_CUSTOM
+#undef HT_KEY_EMPTY
+#undef HT_KEY_GRAVE
+#undef HT_KEY_MEM
+#undef HT_KEY_STR
+#undef HT_KEY_STRPTR
+#undef HT_KEY_EQ
+#undef HT_KEY_HASH
+#undef HT_MAX_DENSITY
+#undef HT_MAX_GRAVE
+#undef HT_VAL
+#undef HT_SHARDS
+
+#undef HT_KEY_LEN
+#undef HT_FAST_HASH
+#undef HT_HASH_SEED
+#undef HT_TABLE_EXTRA_VARS
+#undef HT_FUNC_ATTR
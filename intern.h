@@ -0,0 +1,290 @@
+#ifndef DS_INTERN_H
+#define DS_INTERN_H
+
+#include "ar.h"
+#include "arena.h"
+#include "bigalloc.h"
+#include "common.h"
+#include "hash.h"
+#include "x.h"
+
+#include <assert.h>
+#include <string.h>
+
+/*
+ * # String interning
+ *
+ * Every distinct string is stored once and gets a dense 32-bit id, 0, 1, 2,
+ * ... in the order of first appearance. Ids and the string pointers stay valid
+ * until `ds_intern_deinit`, so tables keyed by strings can be keyed by the ids
+ * with HT_KEY_ATOMIC instead, and compare them with `==`.
+ *
+ * ```c
+ * struct ds_intern in;
+ * ds_intern_init(&in);
+ * u32 a = ds_intern(&in, "foo");
+ * u32 b = ds_intern_n(&in, buf, 3); // buf = "foobar" -> a
+ * puts(ds_intern_str(&in, a));
+ * ds_intern_deinit(&in);
+ * ```
+ *
+ * ## Internal workings
+ *
+ * Strings are copied back to back into blocks of DS_INTERN_BLOCK bytes bump
+ * allocated from an arena.h arena, instead of one malloc each, and are all
+ * freed at once by `ds_intern_deinit`. Each one is NUL terminated and has a
+ * `struct ds_intern_str` header with its hash and length in front, so the hash
+ * is computed once and growing the table never rehashes a string.
+ *
+ * An ht.h table with HT_CTRL maps pointers to the headers to ids, comparing
+ * the hashes and lengths before the characters. To intern a string it is first
+ * copied to the free end of the current block, and that copy is looked up with
+ * `entry`: if the string is new, the copy already is its final place and only
+ * the block's free space moves past it, so a string costs a single probe
+ * either way. Strings too long for that are staged in a scratch buffer.
+ *
+ * An ar.h array of the header pointers maps ids back to the strings.
+ *
+ * ### Functions
+ *
+ * Function            | Description
+ * --------------------|----
+ * ds_intern_init      | Init an empty pool
+ * ds_intern_deinit    | Free all the strings, their ids become invalid
+ * ds_intern           | Id of a NUL terminated string, interning it if new
+ * ds_intern_n         | Id of `len` bytes, which may contain NULs
+ * ds_intern_find      | Id of a string if interned, DS_INTERN_NONE otherwise
+ * ds_intern_bulk      | ds_intern_n for arrays, overlapping the cache misses
+ * ds_intern_str       | The stored string of an id
+ * ds_intern_strlen    | Its length
+ * ds_intern_usage     | Number of strings, their bytes and the memory used
+ */
+
+#ifndef DS_INTERN_BLOCK
+// Size of the arena blocks the strings are copied into
+#  define DS_INTERN_BLOCK (16 * 1024)
+#endif
+
+#define DS_INTERN_NONE UINT32_MAX // returned by ds_intern_find for a miss
+#define DS_INTERN_BATCH 64        // strings per lookup_batch in ds_intern_bulk
+
+// Header in front of every stored string
+struct ds_intern_str {
+  u32 hash;
+  u32 len;
+  char s[]; // NUL terminated
+};
+
+// Bytes taken by a string of length `len` with its header, keeps them aligned
+#define DS_INTERN_SIZE(len)                                                    \
+  ((sizeof(struct ds_intern_str) + (len) + 1 + 3) & ~(size_t)3)
+
+#define HT_PREFIX ds_intern_ht
+#define HT_KEY struct ds_intern_str*
+#define HT_VAL u32
+#define HT_KEY_EQ(a, b)                                                        \
+  ((a)->hash == (b)->hash && (a)->len == (b)->len &&                           \
+   memcmp((a)->s, (b)->s, (a)->len) == 0)
+#define HT_KEY_HASH(k) ((k)->hash)
+#define HT_CTRL
+#define HT_LAYOUT_INLINE
+#define HT_TABLE_EXTRA_VARS size_t bytes; // allocated for the containers
+#define HT_ALLOC(t, size) ((t)->bytes += (size), ds_big_alloc(size))
+#define HT_FREE(t, ptr, size) ((t)->bytes -= (size), ds_big_free(ptr, size))
+#define HT_FUNC_ATTR static inline
+
+#include "ht.h"
+
+struct ds_intern {
+  struct ds_arena arena;         // the strings
+  struct ds_intern_ht_table ids; // string -> id
+  struct ds_intern_str** strs;   // ar.h array, id -> string
+  u32 len;                       // number of interned strings
+  char* pos;                     // free space of the current string block
+  char* end;
+  char* tmp; // scratch for long strings and ds_intern_bulk
+  size_t tmp_cap;
+  size_t chars; // bytes of all strings, with their NULs
+};
+
+struct ds_intern_usage {
+  size_t strings; // number of interned strings
+  size_t chars;   // their bytes including the NULs
+  size_t arena;   // bytes the arena took from malloc for them and the headers
+  size_t table;   // bytes of the table containers
+  size_t ids;     // bytes of the id -> string array
+  size_t total;   // all of the above and the scratch buffer
+};
+
+static void ds_intern_init(struct ds_intern* in) {
+  ds_arena_init(&in->arena);
+  in->ids.bytes = 0;
+  ds_intern_ht_init(&in->ids);
+  arinit(in->strs);
+  in->len = 0;
+  in->pos = in->end = NULL;
+  in->tmp = NULL;
+  in->tmp_cap = 0;
+  in->chars = 0;
+}
+
+/**
+ * Frees all the strings at once.
+ */
+static void ds_intern_deinit(struct ds_intern* in) {
+  ds_arena_deinit(&in->arena);
+  ds_intern_ht_deinit(&in->ids);
+  arfree(in->strs);
+  xfree(in->tmp);
+}
+
+/**
+ * Internal. Writes the header and a copy of `len` bytes at `s` to `p`.
+ */
+static struct ds_intern_str* ds_intern_put(void* p, const char* s,
+                                           size_t len) {
+  assert(len < UINT32_MAX);
+  struct ds_intern_str* k = p;
+  u64 h = ds_hash_wy(s, len, 0);
+  k->hash = (u32)h ^ (u32)(h >> 32);
+  k->len = len;
+  memcpy(k->s, s, len);
+  k->s[len] = 0;
+  return k;
+}
+
+/**
+ * Internal. Scratch space of at least `size` bytes.
+ */
+static char* ds_intern_tmp(struct ds_intern* in, size_t size) {
+  if (size > in->tmp_cap) {
+    in->tmp_cap = ds_max(size, 2 * in->tmp_cap);
+    in->tmp = xrealloc(in->tmp, in->tmp_cap);
+  }
+  return in->tmp;
+}
+
+/**
+ * Internal. Copies the string to the free end of the current block, starting
+ * a new block if it doesn't fit. Long strings go to the scratch space instead.
+ */
+static struct ds_intern_str* ds_intern_stage(struct ds_intern* in,
+                                             const char* s, size_t len) {
+  size_t size = DS_INTERN_SIZE(len);
+  if (size > DS_INTERN_BLOCK / 4)
+    return ds_intern_put(ds_intern_tmp(in, size), s, len);
+  if (size > (size_t)(in->end - in->pos)) {
+    in->pos = ds_arena_alloc(&in->arena, DS_INTERN_BLOCK);
+    in->end = in->pos + DS_INTERN_BLOCK;
+  }
+  return ds_intern_put(in->pos, s, len);
+}
+
+/**
+ * Internal. Gives the next id to the stored string `k`.
+ */
+static u32 ds_intern_push(struct ds_intern* in, struct ds_intern_str* k) {
+  assert(in->len < DS_INTERN_NONE);
+  arpush(in->strs, k);
+  in->chars += (size_t)k->len + 1;
+  return in->len++;
+}
+
+/**
+ * Id of the `len` bytes at `s`. Interns them first if they are new.
+ */
+static u32 ds_intern_n(struct ds_intern* in, const char* s, size_t len) {
+  struct ds_intern_str* k = ds_intern_stage(in, s, len);
+  size_t size = DS_INTERN_SIZE(len);
+  if ((char*)k != in->pos) { // long, gets its own allocation if new
+    u32* id = ds_intern_ht_lookup(&in->ids, k);
+    if (id)
+      return *id;
+    k = memcpy(ds_arena_alloc(&in->arena, size), k, size);
+    ds_intern_ht_insert(&in->ids, k, in->len);
+    return ds_intern_push(in, k);
+  }
+  bool new;
+  u32* id = ds_intern_ht_entry(&in->ids, k, &new);
+  if (new) { // keep the staged copy
+    in->pos += size;
+    *id = ds_intern_push(in, k);
+  }
+  return *id;
+}
+
+/**
+ * Id of the NUL terminated `s`. Interns it first if it's new.
+ */
+static u32 ds_intern(struct ds_intern* in, const char* s) {
+  return ds_intern_n(in, s, strlen(s));
+}
+
+/**
+ * Id of the `len` bytes at `s`, DS_INTERN_NONE if they weren't interned.
+ */
+static u32 ds_intern_find(struct ds_intern* in, const char* s, size_t len) {
+  // the key goes to the scratch space, a miss must not take a new block
+  struct ds_intern_str* k =
+      ds_intern_put(ds_intern_tmp(in, DS_INTERN_SIZE(len)), s, len);
+  u32* id = ds_intern_ht_lookup(&in->ids, k);
+  return id ? *id : DS_INTERN_NONE;
+}
+
+/**
+ * Interns `n` strings and writes their ids to `ids`. `lens` may be NULL for
+ * NUL terminated strings. Hashes DS_INTERN_BATCH strings at a time into the
+ * scratch space and looks them up with `lookup_batch`, so the cache misses of
+ * a batch overlap. Only the new strings are copied again.
+ */
+static void ds_intern_bulk(struct ds_intern* in, size_t n, const char** strs,
+                           const size_t* lens, u32* ids) {
+  struct ds_intern_str* keys[DS_INTERN_BATCH];
+  u32* found[DS_INTERN_BATCH];
+  size_t len[DS_INTERN_BATCH];
+  for (size_t i = 0; i < n; i += DS_INTERN_BATCH) {
+    size_t m = ds_min(n - i, (size_t)DS_INTERN_BATCH);
+    size_t size = 0;
+    for (size_t j = 0; j < m; j++) {
+      len[j] = lens ? lens[i + j] : strlen(strs[i + j]);
+      size += DS_INTERN_SIZE(len[j]);
+    }
+    char* p = ds_intern_tmp(in, size);
+    for (size_t j = 0; j < m; j++) {
+      keys[j] = ds_intern_put(p, strs[i + j], len[j]);
+      p += DS_INTERN_SIZE(len[j]);
+    }
+    // the batch's inserts can't rehash and move the found values
+    ds_intern_ht_reserve(&in->ids, (size_t)in->len + m);
+    ds_intern_ht_lookup_batch(&in->ids, m, keys, found);
+    for (size_t j = 0; j < m; j++)
+      ids[i + j] = found[j] ? *found[j] : ds_intern_n(in, strs[i + j], len[j]);
+  }
+}
+
+/**
+ * The NUL terminated copy of the string with id `id`.
+ */
+static const char* ds_intern_str(struct ds_intern* in, u32 id) {
+  assert(id < in->len);
+  return in->strs[id]->s;
+}
+
+static size_t ds_intern_strlen(struct ds_intern* in, u32 id) {
+  assert(id < in->len);
+  return in->strs[id]->len;
+}
+
+static struct ds_intern_usage ds_intern_usage(struct ds_intern* in) {
+  struct ds_intern_usage u = {
+      .strings = in->len,
+      .chars = in->chars,
+      .arena = in->arena.reserved,
+      .table = in->ids.bytes,
+      .ids = sizeof(*in->strs) * arcap(in->strs),
+  };
+  u.total = u.arena + u.table + u.ids + in->tmp_cap;
+  return u;
+}
+
+#endif
@@ -0,0 +1,284 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * # Ring buffer generator header
+ *
+ * ## Usage
+ *
+ * Bounded FIFO queue of RING_TYPE elements for passing items between threads.
+ * Single producer single consumer by default, any number of producers and
+ * consumers with RING_MPMC.
+ *
+ * ```c
+ * #define RING_PREFIX jobs
+ * #define RING_TYPE struct job
+ * #include "ring.h"
+ *
+ * struct jobs_ring q;
+ * jobs_init(&q, 1024);
+ *
+ * // producer thread
+ * while (!jobs_push(&q, job))
+ *   wait_a_bit();
+ *
+ * // consumer thread
+ * struct job batch[32];
+ * size_t n = jobs_pop_n(&q, batch, 32);
+ * ```
+ *
+ * Nothing blocks: `push` returns false on a full ring and `pop` on an empty
+ * one, the caller decides whether to spin, yield or sleep.
+ *
+ * ## Internal workings
+ *
+ * The capacity is a power of two and `head` and `tail` count up forever, slot
+ * `i` is at `i & mask`. The read-only part, the producer side and the consumer
+ * side each have their own cache line, so the two sides only share a line when
+ * one of them actually needs to see the progress of the other.
+ *
+ * SPSC: The producer owns `head` and the consumer `tail`, each publishes its
+ * index with a release store after writing or reading the slots. Both keep a
+ * copy of the other side's index and only reload it when the copy says the
+ * ring is full (or empty), so a steady stream mostly touches its own line.
+ * Every call finishes in a bounded number of steps (wait-free).
+ *
+ * MPMC: Every slot has a sequence number next to the element (Vyukov's bounded
+ * queue). A slot with sequence `i` is free for the producer of position `i`,
+ * with `i + 1` it holds the element for the consumer of position `i`, who sets
+ * it to `i + cap` for the next lap. A producer checks that the slots are free,
+ * claims them by a CAS on `head` and releases each by bumping its sequence
+ * number, consumers do the same on `tail`. A batch claims a whole run of ready
+ * slots with a single CAS. Lock-free: a thread stalled between claiming and
+ * releasing a slot holds up the consumers of that slot, not the other threads.
+ *
+ * ## Required macros
+ *
+ * RING_PREFIX - value of this is used as the prefix for all functions
+ * RING_TYPE - the element type
+ *
+ * ### Switches
+ *
+ * RING_MPMC - allow multiple producers and multiple consumers
+ * RING_FUNC_ATTR - Attributes of all functions, e.g. `static inline`
+ *
+ * ### Functions
+ *
+ * Function | Description
+ * ---------|----
+ * init     | Init a ring for at least `cap` elements, rounded up to a power of 2
+ * deinit   | Free memory used by a ring
+ * alloc    | Alloc + init a ring
+ * free     | Free memory used by a ring and the ring itself
+ *
+ * push     | Add an element. Returns false if the ring is full.
+ * pop      | Take the oldest element to `out`. Returns false if empty.
+ * push_n   | Add up to `n` elements, returns how many fit.
+ * pop_n    | Take up to `n` elements, returns how many there were.
+ * len      | Number of elements. Exact only while nobody pushes or pops.
+ */
+
+#ifndef RING_TYPE
+#  error You have to define RING_TYPE
+#endif
+
+#ifndef RING_FUNC_ATTR
+#  define RING_FUNC_ATTR
+#endif
+
+#define P(x) ds_glue_expanded_(RING_PREFIX, x)
+
+// shortcuts
+#define E RING_TYPE
+#define R struct P(ring)
+
+#ifdef RING_MPMC
+#  define SLOT struct P(slot)
+#  define ELEM(r, i) (r)->slots[(i) & (r)->mask].val
+#  define SEQ(r, i) (r)->slots[(i) & (r)->mask].seq
+
+struct P(slot) {
+  size_t seq; // position this slot is ready for, see above
+  E val;
+};
+#else
+#  define SLOT E
+#  define ELEM(r, i) (r)->slots[(i) & (r)->mask]
+#endif
+
+#define LINE __attribute__((aligned(64)))
+
+struct P(ring) {
+  size_t mask; // capacity - 1
+  SLOT* slots;
+
+  LINE size_t head; // next position to push to
+#ifndef RING_MPMC
+  size_t tail_copy; // producer's last view of `tail`
+#endif
+
+  LINE size_t tail; // next position to pop from
+#ifndef RING_MPMC
+  size_t head_copy; // consumer's last view of `head`
+#endif
+} LINE;
+
+RING_FUNC_ATTR void P(init)(R* r, size_t cap) {
+  size_t c = 2; // MPMC can't tell a free slot from a full one with 1
+  while (c < cap)
+    c *= 2;
+  r->mask = c - 1;
+  size_t size = (sizeof(SLOT) * c + 63) & ~(size_t)63;
+  r->slots = aligned_alloc(64, size);
+  r->head = r->tail = 0;
+#ifdef RING_MPMC
+  for (size_t i = 0; i < c; i++)
+    r->slots[i].seq = i;
+#else
+  r->tail_copy = r->head_copy = 0;
+#endif
+}
+
+RING_FUNC_ATTR void P(deinit)(R* r) { free(r->slots); }
+
+RING_FUNC_ATTR R* P(alloc)(size_t cap) {
+  R* r = aligned_alloc(64, sizeof(R));
+  P(init)(r, cap);
+  return r;
+}
+
+RING_FUNC_ATTR void P(free)(R* r) {
+  P(deinit)(r);
+  free(r);
+}
+
+#ifndef RING_MPMC
+
+/**
+ * Adds up to `n` elements of `xs`. Returns the number added, which is less
+ * than `n` only if the ring filled up. Producer only.
+ */
+RING_FUNC_ATTR size_t P(push_n)(R* r, const E* xs, size_t n) {
+  size_t h = r->head;
+  size_t cap = r->mask + 1;
+  if (h + n - r->tail_copy > cap) {
+    r->tail_copy = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    n = ds_min(n, cap - (h - r->tail_copy));
+  }
+  for (size_t i = 0; i < n; i++)
+    ELEM(r, h + i) = xs[i];
+  __atomic_store_n(&r->head, h + n, __ATOMIC_RELEASE);
+  return n;
+}
+
+/**
+ * Takes up to `n` of the oldest elements to `out`. Returns their number.
+ * Consumer only.
+ */
+RING_FUNC_ATTR size_t P(pop_n)(R* r, E* out, size_t n) {
+  size_t t = r->tail;
+  if (t + n > r->head_copy) {
+    r->head_copy = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    n = ds_min(n, r->head_copy - t);
+  }
+  for (size_t i = 0; i < n; i++)
+    out[i] = ELEM(r, t + i);
+  __atomic_store_n(&r->tail, t + n, __ATOMIC_RELEASE);
+  return n;
+}
+
+#else
+
+/**
+ * Adds up to `n` elements of `xs`. Returns the number added, which is less
+ * than `n` only if the ring filled up.
+ */
+RING_FUNC_ATTR size_t P(push_n)(R* r, const E* xs, size_t n) {
+  size_t h = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+  size_t k;
+  for (;;) {
+    // the run of free slots from `h`
+    for (k = 0; k < n; k++)
+      if (__atomic_load_n(&SEQ(r, h + k), __ATOMIC_ACQUIRE) != h + k)
+        break;
+    if (k == 0) {
+      // full, unless another producer got ahead of us
+      size_t c = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+      if (c == h)
+        return 0;
+      h = c;
+    } else if (__atomic_compare_exchange_n(&r->head, &h, h + k, true,
+                                           __ATOMIC_RELAXED,
+                                           __ATOMIC_RELAXED))
+      break;
+  }
+  for (size_t i = 0; i < k; i++) {
+    ELEM(r, h + i) = xs[i];
+    __atomic_store_n(&SEQ(r, h + i), h + i + 1, __ATOMIC_RELEASE);
+  }
+  return k;
+}
+
+/**
+ * Takes up to `n` of the oldest elements to `out`. Returns their number.
+ */
+RING_FUNC_ATTR size_t P(pop_n)(R* r, E* out, size_t n) {
+  size_t t = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+  size_t k;
+  for (;;) {
+    // the run of filled slots from `t`
+    for (k = 0; k < n; k++)
+      if (__atomic_load_n(&SEQ(r, t + k), __ATOMIC_ACQUIRE) != t + k + 1)
+        break;
+    if (k == 0) {
+      // empty, unless another consumer got ahead of us
+      size_t c = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+      if (c == t)
+        return 0;
+      t = c;
+    } else if (__atomic_compare_exchange_n(&r->tail, &t, t + k, true,
+                                           __ATOMIC_RELAXED,
+                                           __ATOMIC_RELAXED))
+      break;
+  }
+  size_t cap = r->mask + 1;
+  for (size_t i = 0; i < k; i++) {
+    out[i] = ELEM(r, t + i);
+    __atomic_store_n(&SEQ(r, t + i), t + i + cap, __ATOMIC_RELEASE);
+  }
+  return k;
+}
+
+#endif
+
+/**
+ * Adds an element. Returns false if the ring is full.
+ */
+RING_FUNC_ATTR bool P(push)(R* r, E x) { return P(push_n)(r, &x, 1); }
+
+/**
+ * Takes the oldest element to `out`. Returns false if the ring is empty.
+ */
+RING_FUNC_ATTR bool P(pop)(R* r, E* out) { return P(pop_n)(r, out, 1); }
+
+RING_FUNC_ATTR size_t P(len)(R* r) {
+  size_t t = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+  size_t h = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+  return h > t ? h - t : 0;
+}
+
+#undef P
+#undef E
+#undef R
+#undef SLOT
+#undef ELEM
+#undef SEQ
+#undef LINE
+
+#undef RING_PREFIX
+#undef RING_TYPE
+#undef RING_MPMC
+#undef RING_FUNC_ATTR
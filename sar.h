@@ -0,0 +1,121 @@
+#ifndef DS_SAR_H
+#define DS_SAR_H
+
+#include "common.h"
+
+/*
+ * Segmented array. Same idea as ar.h, but the elements live in blocks of
+ * SAR_FIRST, 2*SAR_FIRST, 4*SAR_FIRST, ... elements. Growing allocates the next
+ * block and never copies, so pointers to elements stay valid and there is no
+ * 2x memory peak. Element `i` is in block log2(i / SAR_FIRST + 1), found in
+ * O(1) with a clz.
+ *
+ * The handle `p` is a pointer to the block table, `int** p; sarinit(p);`.
+ * `sarat(p, i)` is the element as an lvalue.
+ *
+ * Unlike arpushm, sarpushm returns the index of the first new element because
+ * the new elements don't have to be contiguous.
+ */
+
+// Allocator of the blocks, ds_realloc if it's defined (like for ar.h), realloc
+// otherwise. Doesn't define ds_realloc, which would turn off bigalloc.h in ar.h
+// when sar.h is included first.
+#ifndef sar_realloc
+#  ifdef ds_realloc
+#    define sar_realloc(p, size) ds_realloc(p, size)
+#  else
+#    define sar_realloc(p, size) realloc(p, size)
+#  endif
+#endif
+
+#ifndef SAR_FIRST
+// Elements in the first block, power of two
+#  define SAR_FIRST 8
+#endif
+
+#define SAR_BLOCKS 48
+
+struct sar_head {
+  size_t len, cap;
+  void* blocks[SAR_BLOCKS]; // this is where `p` points
+};
+
+#define sar_block(i) (63 - __builtin_clzll((u64)(i) / SAR_FIRST + 1))
+
+#define sarinit(p)                                                             \
+  do {                                                                         \
+    struct sar_head* _h = sar_realloc(NULL, sizeof(*_h));                      \
+    _h->len = 0;                                                               \
+    _h->cap = 0;                                                               \
+    p = (typeof(p))&_h->blocks;                                                \
+  } while (0)
+
+#define sarfree(p)                                                             \
+  do {                                                                         \
+    struct sar_head* _h = ds_skip_back(struct sar_head, blocks, p);            \
+    for (size_t _b = 0; _h->cap > SAR_FIRST * ((1ull << _b) - 1); _b++) {     \
+      ds_unused void* _ = sar_realloc(p[_b], 0);                               \
+    }                                                                          \
+    ds_unused void* _ = sar_realloc(_h, 0);                                    \
+  } while (0)
+
+#define sarlen(p)                                                              \
+  ({                                                                           \
+    struct sar_head* _h = ds_skip_back(struct sar_head, blocks, p);            \
+    _h->len;                                                                   \
+  })
+
+#define sarcap(p)                                                              \
+  ({                                                                           \
+    struct sar_head* _h = ds_skip_back(struct sar_head, blocks, p);            \
+    _h->cap;                                                                   \
+  })
+
+#define sarat(p, i)                                                            \
+  (*({                                                                         \
+    size_t _i = (i);                                                           \
+    size_t _b = sar_block(_i);                                                 \
+    &(p)[_b][_i + SAR_FIRST - ((size_t)SAR_FIRST << _b)];                      \
+  }))
+
+#define sarpushm(p, n)                                                         \
+  ({                                                                           \
+    struct sar_head* _h = ds_skip_back(struct sar_head, blocks, p);            \
+    size_t _l = _h->len;                                                       \
+    _h->len += n;                                                              \
+    while (_h->len > _h->cap) {                                                \
+      size_t _b = sar_block(_h->cap);                                          \
+      p[_b] = sar_realloc(NULL, sizeof(**(p)) * ((size_t)SAR_FIRST << _b));    \
+      _h->cap += (size_t)SAR_FIRST << _b;                                      \
+    }                                                                          \
+    _l;                                                                        \
+  })
+
+#define sarpush(p, val)                                                        \
+  do {                                                                         \
+    sarat(p, sarpushm(p, 1)) = val;                                            \
+  } while (0)
+
+#define sarpop(p)                                                              \
+  ({                                                                           \
+    struct sar_head* _h = ds_skip_back(struct sar_head, blocks, p);            \
+    typeof(**(p)) _c = sarat(p, --_h->len);                                    \
+    _c;                                                                        \
+  })
+
+#define sarpeek(p)                                                             \
+  ({                                                                           \
+    struct sar_head* _h = ds_skip_back(struct sar_head, blocks, p);            \
+    typeof(**(p)) _c = sarat(p, _h->len - 1);                                  \
+    _c;                                                                        \
+  })
+
+// foreach by value
+#define sarforev(p, v)                                                         \
+  for (size_t _i = 0, _e = sarlen(p), _k = 1; _k; _k = 0)                      \
+    for (typeof(**(p)) v; _i < _e && (v = sarat(p, _i), 1); _i++)
+
+// foreach by index
+#define sarforei(p, i) for (size_t i = 0, end = sarlen(p); i < end; i++)
+
+#endif
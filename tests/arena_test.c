@@ -0,0 +1,86 @@
+#include "../arena.h"
+#include "test.h"
+
+struct ds_arena arena;
+#define ds_realloc(p, s) ds_arena_realloc(&arena, p, s)
+#include "../ar.h"
+
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX test
+#define HT_KEY_ATOMIC
+#define HT_KEY_EMPTY -1
+#define HT_KEY_GRAVE -2
+#define HT_TABLE_EXTRA_VARS struct ds_arena* arena;
+#define HT_ALLOC(t, size) ds_arena_palloc((t)->arena, size)
+#define HT_FREE(t, ptr, size) ds_arena_pfree((t)->arena, ptr)
+#include "../ht.h"
+
+void test_bump() {
+  ds_arena_init(&arena);
+  char* a = ds_arena_alloc(&arena, 3);
+  char* b = ds_arena_alloc(&arena, 100);
+  assert((uintptr_t)a % DS_ARENA_ALIGN == 0);
+  assert((uintptr_t)b % DS_ARENA_ALIGN == 0);
+  assert(b >= a + 3);
+  memset(b, 1, 100);
+
+  // bigger than a chunk
+  char* c = ds_arena_alloc(&arena, DS_ARENA_CHUNK * 3);
+  memset(c, 2, DS_ARENA_CHUNK * 3);
+  char* d = ds_arena_alloc(&arena, 1);
+  assert(d == b + 112); // still bumping in the old chunk
+  ds_arena_deinit(&arena);
+}
+
+void test_pool() {
+  ds_arena_init(&arena);
+  void* a = ds_arena_palloc(&arena, 100);
+  ds_arena_pfree(&arena, a);
+  assert(arena.used == 0);
+  void* b = ds_arena_palloc(&arena, 90); // same size class
+  assert(a == b);
+  b = ds_arena_realloc(&arena, b, 50); // fits, stays
+  assert(a == b);
+  b = ds_arena_realloc(&arena, b, 500);
+  assert(a != b);
+  ds_arena_realloc(&arena, b, 0);
+  assert(arena.used == 0);
+  ds_arena_deinit(&arena);
+}
+
+void test_generators(size_t iter) {
+  ds_arena_init(&arena);
+  int* a;
+  arinit(a);
+  for (size_t i = 0; i < iter; i++)
+    arpush(a, i);
+  for (size_t i = 0; i < iter; i++)
+    assert(a[i] == i);
+
+  struct test_table t;
+  t.arena = &arena;
+  test_init(&t);
+  for (size_t i = 0; i < iter; i++)
+    assert(test_insert(&t, i, i * 2));
+  for (size_t i = 0; i < iter; i++)
+    assert(*test_lookup(&t, i) == i * 2);
+  test_deinit(&t);
+
+  // the allocator is set before the first HT_ALLOC
+  struct test_table* p = test_alloc_with(&(struct test_table){.arena = &arena});
+  for (size_t i = 0; i < iter; i++)
+    assert(test_insert(p, i, i));
+  assert(p->arena == &arena && *test_lookup(p, iter - 1) == iter - 1);
+  test_free(p);
+
+  arfree(a);
+  assert(arena.used == 0);
+  ds_arena_deinit(&arena); // would free both even without the frees above
+}
+
+int main() {
+  test_bump();
+  test_pool();
+  test_generators(10000);
+}
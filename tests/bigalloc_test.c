@@ -0,0 +1,55 @@
+#define DS_BIG_THRESHOLD (16 * 4096)
+#include "../ar.h"
+#include "test.h"
+
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX test
+#define HT_KEY_ATOMIC
+#define HT_KEY_EMPTY -1
+#define HT_KEY_GRAVE -2
+#include "../ht.h"
+
+void test_realloc() {
+  // small -> small -> big -> big (mremap) -> small -> free
+  size_t sizes[] = {100, 1000, DS_BIG_THRESHOLD, DS_BIG_THRESHOLD * 5, 10, 0};
+  char* p = ds_big_realloc(NULL, 0, 10);
+  size_t old = 10;
+  memset(p, 7, old);
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); i++) {
+    p = ds_big_realloc(p, old, sizes[i]);
+    for (size_t j = 0; j < ds_min(old, sizes[i]); j++)
+      assert(p[j] == 7);
+    if (sizes[i])
+      memset(p, 7, sizes[i]);
+    old = sizes[i];
+  }
+  assert(!p);
+}
+
+void test_ar(size_t iter) {
+  int* a;
+  arinit(a);
+  for (size_t i = 0; i < iter; i++)
+    arpush(a, i);
+  for (size_t i = 0; i < iter; i++)
+    assert(a[i] == i);
+  escape(a);
+  arfree(a);
+}
+
+void test_ht(int size) {
+  struct test_table t;
+  test_init(&t);
+  for (int i = 0; i < size; i++)
+    assert(test_insert(&t, i, i));
+  for (int i = 0; i < size; i++)
+    assert(*test_lookup(&t, i) == i);
+  test_deinit(&t);
+}
+
+int main() {
+  test_realloc();
+  test_ar(1 << 20);
+  test_ht(1 << 17);
+}
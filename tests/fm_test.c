@@ -0,0 +1,146 @@
+#define FM_KEY u32
+#define FM_VAL u32
+#define FM_PREFIX test
+#define FM_KEY_ATOMIC
+
+#include "../fm.h"
+
+#define FM_KEY int
+#define FM_PREFIX set
+#define FM_KEY_ATOMIC
+
+#include "../fm.h"
+
+#define FM_VAL int
+#define FM_PREFIX word
+#define FM_KEY_STR
+#define FM_KEY_LEN 8
+
+#include "../fm.h"
+
+#define FM_KEY int
+#define FM_VAL int
+#define FM_PREFIX desc
+#define FM_KEY_LESS(a, b) ((a) > (b))
+
+#include "../fm.h"
+
+static int cmp_u32(const void* a, const void* b) {
+  u32 x = *(const u32*)a, y = *(const u32*)b;
+  return x < y ? -1 : x > y;
+}
+
+// index of the first element of the sorted `s` that is >= k (> k with `upper`)
+static size_t bound(u32* s, size_t n, u32 k, bool upper) {
+  size_t lo = 0, hi = n;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (upper ? s[mid] <= k : s[mid] < k)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+int main() {
+  struct test_map m;
+  test_init(&m);
+  assert(!test_lookup(&m, 1) && !test_first(&m) && !test_lower_bound(&m, 1));
+  test_finalize(&m);
+  assert(m.len == 0);
+
+  // even keys, so that odd ones miss; every key twice, the first one wins
+  size_t n = 10000;
+  u32* sorted = malloc(sizeof(u32) * n);
+  for (size_t i = 0; i < n; i++)
+    sorted[i] = (u32)(i * 2654435761u) & ~1u;
+  for (size_t i = 0; i < n; i++)
+    test_add(&m, sorted[i], sorted[i] / 2);
+  for (size_t i = 0; i < n; i++)
+    test_add(&m, sorted[i], 0);
+  assert(!test_lookup(&m, sorted[0])); // not finalized yet
+  test_finalize(&m);
+  qsort(sorted, n, sizeof(u32), cmp_u32);
+  assert(m.len == n);
+
+  for (size_t i = 0; i < n; i++) {
+    assert(*test_lookup(&m, sorted[i]) == sorted[i] / 2);
+    assert(!test_lookup(&m, sorted[i] + 1));
+    assert(test_contains(&m, sorted[i]));
+  }
+  for (size_t i = 0; i < n; i++) {
+    u32 k = sorted[i] + (i % 3) - 1;
+    size_t lb = bound(sorted, n, k, false);
+    size_t ub = bound(sorted, n, k, true);
+    size_t p = test_lower_bound(&m, k);
+    assert(lb == n ? !p : m.keys[p] == sorted[lb]);
+    p = test_upper_bound(&m, k);
+    assert(ub == n ? !p : m.keys[p] == sorted[ub]);
+  }
+
+  // in order forwards and backwards
+  size_t j = 0;
+  fm_foreach(test, &m, k, v) {
+    assert(*k == sorted[j++] && *v == *k / 2);
+  }
+  assert(j == n);
+  for (size_t p = test_last(&m); p; p = test_pred(&m, p))
+    assert(m.keys[p] == sorted[--j]);
+  assert(j == 0);
+
+  // range [sorted[100], sorted[200])
+  j = 100;
+  fm_foreach_from(test, &m, test_lower_bound(&m, sorted[100]), k, v) {
+    if (!test_less(*k, sorted[200]))
+      break;
+    assert(*k == sorted[j++]);
+  }
+  assert(j == 200);
+
+  // pairs added later are merged in, the old ones win over duplicates
+  test_add(&m, 1, 7);
+  test_add(&m, sorted[5], 0);
+  test_finalize(&m);
+  assert(m.len == n + 1 && *test_lookup(&m, 1) == 7);
+  assert(*test_lookup(&m, sorted[5]) == sorted[5] / 2);
+  assert(m.keys[test_succ(&m, test_first(&m))] == 1); // right after 0
+  test_deinit(&m);
+  free(sorted);
+
+  struct set_map s;
+  int ks[] = {5, 3, 9, 3, 1};
+  set_build(&s, 5, ks);
+  assert(s.len == 4 && set_contains(&s, 9) && !set_contains(&s, 4));
+  int prev = 0;
+  fm_foreach_key(set, &s, k) {
+    assert(*k > prev);
+    prev = *k;
+  }
+  assert(prev == 9);
+  set_deinit(&s);
+
+  struct word_map w;
+  word_init(&w);
+  char words[][8] = {"pear", "apple", "plum", "fig"};
+  for (int i = 0; i < 4; i++)
+    word_add(&w, words[i], i);
+  word_finalize(&w);
+  assert(*word_lookup(&w, words[2]) == 2);
+  char fi[8] = "fi";
+  assert(!word_lookup(&w, fi));
+  assert(!strcmp(w.keys[word_lower_bound(&w, fi)], "fig"));
+  assert(!strcmp(w.keys[word_first(&w)], "apple"));
+  word_deinit(&w);
+
+  struct desc_map d;
+  desc_init(&d);
+  for (int i = 0; i < 100; i++)
+    desc_add(&d, i, -i);
+  desc_finalize(&d);
+  int expect = 99;
+  fm_foreach(desc, &d, k, v) {
+    assert(*k == expect-- && *v == -*k);
+  }
+  desc_deinit(&d);
+}
@@ -0,0 +1,97 @@
+#define HEAP_PREFIX bin
+#define HEAP_TYPE int
+#define HEAP_ARITY 2
+
+#include "../heap.h"
+
+#define HEAP_PREFIX quad
+#define HEAP_TYPE int
+
+#include "../heap.h"
+
+#define HEAP_PREFIX oct
+#define HEAP_TYPE int
+#define HEAP_ARITY 8
+
+#include "../heap.h"
+
+struct timer {
+  u64 deadline;
+  u32 id;
+};
+
+static size_t pos[1000];
+
+#define HEAP_PREFIX timers
+#define HEAP_TYPE struct timer
+#define HEAP_LESS(a, b) ((a).deadline < (b).deadline)
+#define HEAP_SET_INDEX(e, i) (pos[(e).id] = (i))
+
+#include "../heap.h"
+
+#define CHECK_HEAP(prefix)                                                     \
+  do {                                                                         \
+    struct prefix##_heap h;                                                    \
+    prefix##_init(&h);                                                         \
+    int n = 5000;                                                              \
+    for (int i = 0; i < n; i++)                                                \
+      prefix##_push(&h, (i * 7919) % n);                                       \
+    assert(h.len == (size_t)n && prefix##_peek(&h) == 0);                      \
+    for (int i = 0; i < n; i++)                                                \
+      assert(prefix##_pop(&h) == i);                                           \
+    assert(h.len == 0);                                                        \
+                                                                               \
+    int xs[1000];                                                              \
+    for (int i = 0; i < 1000; i++)                                             \
+      xs[i] = (i * 31) % 1000;                                                 \
+    prefix##_push(&h, 500);                                                    \
+    prefix##_heapify(&h, xs, 1000);                                            \
+    assert(h.len == 1001 && prefix##_pop(&h) == 0);                            \
+    for (int i = 1; i < 1000; i++) {                                           \
+      assert(prefix##_pop(&h) == i);                                           \
+      if (i == 500)                                                            \
+        assert(prefix##_pop(&h) == 500);                                       \
+    }                                                                          \
+    assert(h.len == 0);                                                        \
+    prefix##_deinit(&h);                                                       \
+  } while (0)
+
+int main() {
+  CHECK_HEAP(bin);
+  CHECK_HEAP(quad);
+  CHECK_HEAP(oct);
+
+  struct timers_heap h;
+  timers_init(&h);
+  for (u32 i = 0; i < 1000; i++) {
+    timers_push(&h, (struct timer){1000 + (i * 7919) % 1000, i});
+    // groups of 4 siblings are cache line aligned
+    assert((uintptr_t)(h.e + 1) % 64 == 0);
+  }
+  for (u32 i = 0; i < 1000; i++)
+    assert(h.e[pos[i]].id == i);
+
+  // move timers 0..99 to the front, drop 100..199
+  for (u32 i = 0; i < 100; i++)
+    timers_decrease(&h, pos[i], (struct timer){i, i});
+  for (u32 i = 100; i < 200; i++)
+    assert(timers_remove(&h, pos[i]).id == i);
+  // push 200..299 to the back
+  for (u32 i = 200; i < 300; i++) {
+    h.e[pos[i]].deadline = 5000 + i;
+    timers_update(&h, pos[i]);
+  }
+  assert(h.len == 900);
+  for (u32 i = 0; i < 100; i++)
+    assert(timers_pop(&h).id == i);
+  u64 last = 0;
+  for (u32 i = 0; i < 700; i++) {
+    struct timer t = timers_pop(&h);
+    assert(t.id >= 300 && t.deadline >= last);
+    last = t.deadline;
+  }
+  for (u32 i = 200; i < 300; i++)
+    assert(timers_pop(&h).id == i);
+  assert(h.len == 0);
+  timers_deinit(&h);
+}
@@ -0,0 +1,45 @@
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX test
+#define HT_KEY_ATOMIC
+#define HT_BATCH 8
+
+#define HT_KEY_EMPTY -1
+#define HT_KEY_GRAVE -2
+
+#include "../ht.h"
+
+int main() {
+  struct test_table t;
+  test_init(&t);
+  int size = 1000;
+  int keys[2000], vals[2000];
+  int* out[2000];
+  bool found[2000];
+
+  for (int i = 0; i < size; i++) {
+    keys[i] = i;
+    vals[i] = i * 3;
+  }
+  // check that batches insert everything, duplicates included
+  assert(test_insert_batch(&t, size, keys, vals) == size);
+  assert(test_insert_batch(&t, size, keys, vals) == 0);
+  assert(t.len == size);
+
+  // half of the keys are missing, size is not a multiple of the batch
+  for (int i = 0; i < 2 * size - 3; i++)
+    keys[i] = i;
+  test_lookup_batch(&t, 2 * size - 3, keys, out);
+  test_contains_batch(&t, 2 * size - 3, keys, found);
+  for (int i = 0; i < 2 * size - 3; i++) {
+    if (i < size) {
+      assert(*out[i] == i * 3);
+      assert(found[i]);
+    } else {
+      assert(!out[i]);
+      assert(!found[i]);
+    }
+  }
+
+  test_deinit(&t);
+}
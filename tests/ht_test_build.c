@@ -0,0 +1,86 @@
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX test
+#define HT_KEY_ATOMIC
+
+#define HT_KEY_EMPTY -1
+#define HT_KEY_GRAVE -2
+#define HT_MIN_DENSITY 0.125
+
+#include "../ht.h"
+
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX ctrl
+#define HT_KEY_ATOMIC
+#define HT_CTRL
+
+#include "../ht.h"
+
+int main() {
+  struct test_table t;
+  test_init(&t);
+  int size = 100000;
+
+  // reserve sizes the table once
+  test_reserve(&t, size);
+  size_t cap = t.cap;
+  assert(cap >= 2 * size && cap < 4 * size);
+  for (int i = 0; i < size; i++)
+    assert(test_insert(&t, i, i));
+  assert(t.cap == cap);
+  test_reserve(&t, 10); // never shrinks
+  assert(t.cap == cap);
+
+  // with HT_MIN_DENSITY removing most of the keys shrinks automatically
+  bool b = false;
+  for (int i = 0; i < size; i++)
+    if (i % 100)
+      assert(test_remove(&t, i, &b) == i);
+  assert(t.len == size / 100);
+  assert(t.cap < cap / 8);
+  assert(t.len <= 0.5 * t.cap);
+  for (int i = 0; i < size; i += 100)
+    assert(*test_lookup(&t, i) == i);
+
+  // shrink_to_fit also gets rid of the graves
+  test_remove(&t, 0, &b);
+  test_shrink_to_fit(&t);
+  assert(t.graves == 0);
+  assert(t.len > 0.25 * t.cap && t.len <= 0.5 * t.cap);
+  assert(!test_contains(&t, 0));
+  for (int i = 100; i < size; i += 100)
+    assert(*test_lookup(&t, i) == i);
+  test_deinit(&t);
+
+  // build from arrays, duplicates keep the first value
+  int* keys = malloc(sizeof(int) * size);
+  int* vals = malloc(sizeof(int) * size);
+  for (int i = 0; i < size; i++) {
+    keys[i] = (i * 7919) % (size / 2);
+    vals[i] = i;
+  }
+  test_build(&t, size, keys, vals);
+  assert(t.len == size / 2);
+  for (int i = 0; i < size / 2; i++)
+    assert(*test_lookup(&t, keys[i]) == i);
+  test_deinit(&t);
+
+  struct ctrl_table c;
+  ctrl_build(&c, size, keys, vals);
+  assert(c.len == size / 2);
+  for (int i = 0; i < size / 2; i++)
+    assert(*ctrl_lookup(&c, keys[i]) == i);
+
+  // without it only shrink_to_fit shrinks
+  cap = c.cap;
+  for (int i = 1; i < size / 2; i++)
+    ctrl_remove(&c, i, &b);
+  assert(c.len == 1 && c.cap == cap);
+  ctrl_shrink_to_fit(&c);
+  assert(c.cap < cap && *ctrl_lookup(&c, 0) == vals[0]);
+  ctrl_deinit(&c);
+
+  free(keys);
+  free(vals);
+}
@@ -0,0 +1,70 @@
+// Insert/remove churn at densities where live keys plus graves could fill the
+// table, misses must still find an empty slot.
+
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX lin
+#define HT_KEY_ATOMIC
+#define HT_KEY_EMPTY -1
+#define HT_KEY_GRAVE -2
+#define HT_MAX_DENSITY 0.875
+
+#include "../ht.h"
+
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX lin75
+#define HT_KEY_ATOMIC
+#define HT_KEY_EMPTY -1
+#define HT_KEY_GRAVE -2
+#define HT_MAX_DENSITY 0.75
+
+#include "../ht.h"
+
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX ctrl
+#define HT_KEY_ATOMIC
+#define HT_CTRL
+#define HT_MAX_DENSITY 0.875
+
+#include "../ht.h"
+
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX inc
+#define HT_KEY_ATOMIC
+#define HT_KEY_EMPTY -1
+#define HT_KEY_GRAVE -2
+#define HT_INCREMENTAL
+#define HT_MAX_DENSITY 0.875
+
+#include "../ht.h"
+
+// keeps a window of `n` live keys sliding over 0..rounds
+#define CHECK_CHURN(prefix, n, rounds)                                         \
+  do {                                                                         \
+    struct prefix##_table t;                                                   \
+    prefix##_init(&t);                                                         \
+    for (int i = 0; i < n; i++)                                                \
+      assert(prefix##_insert(&t, i, i));                                       \
+    for (int i = n; i < rounds; i++) {                                         \
+      bool b = false;                                                          \
+      assert(prefix##_remove(&t, i - n, &b) == i - n && b);                    \
+      assert(prefix##_insert(&t, i, i));                                       \
+      assert(!prefix##_lookup(&t, -i - 3)); /* a miss probes to an empty */    \
+      assert(t.len + t.graves < t.cap);                                        \
+    }                                                                          \
+    assert(t.len == n);                                                        \
+    for (int i = rounds - n; i < rounds; i++)                                  \
+      assert(*prefix##_lookup(&t, i) == i);                                    \
+    prefix##_deinit(&t);                                                       \
+  } while (0)
+
+int main() {
+  // just below a power of two times the density, so the table stays full
+  CHECK_CHURN(lin, 890, 100000);
+  CHECK_CHURN(lin75, 760, 100000);
+  CHECK_CHURN(ctrl, 890, 100000);
+  CHECK_CHURN(inc, 890, 100000);
+}
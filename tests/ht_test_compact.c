@@ -0,0 +1,99 @@
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX test
+#define HT_KEY_ATOMIC
+#define HT_COMPACT
+
+#include "../ht.h"
+
+#define HT_VAL int
+#define HT_PREFIX name
+#define HT_KEY_STRPTR
+#define HT_COMPACT
+
+#include "../ht.h"
+
+#include <stdio.h>
+
+int main() {
+  struct test_table t;
+  test_init(&t);
+  int size = 100000;
+
+  // index slots widen from 8 to 16 to 32 bits while growing
+  for (int i = 0; i < size; i++) {
+    assert(test_insert(&t, i, i));
+    assert(!test_insert(&t, i / 2, 0));
+    if (i == 50)
+      assert(test__ix_shift(t.cap) == 0);
+    if (i == 5000)
+      assert(test__ix_shift(t.cap) == 1);
+  }
+  assert(test__ix_shift(t.cap) == 2);
+  assert(t.len == size);
+
+  // pairs come in insertion order
+  int n = 0;
+  ht_foreach(test, &t, k, v) {
+    assert(*k == n && *v == n);
+    n++;
+  }
+  assert(n == size);
+
+  // remove every odd key and insert it again, it moves to the end
+  for (int i = 1; i < size; i += 2) {
+    bool b = false;
+    assert(test_remove(&t, i, &b) == i);
+    assert(b);
+  }
+  assert(t.len == size / 2);
+  for (int i = 0; i < size; i++)
+    assert(test_contains(&t, i) == !(i % 2));
+  for (int i = 1; i < size; i += 2)
+    test_update(&t, i, -i);
+  n = 0;
+  size_t it = 0;
+  int* k;
+  int* v;
+  while (test_next(&t, &it, &k, &v)) {
+    if (n < size / 2)
+      assert(*k == 2 * n && *v == 2 * n);
+    else
+      assert(*k == 2 * (n - size / 2) + 1 && *v == -*k);
+    n++;
+  }
+  assert(n == size);
+
+  // churn in a table that doesn't grow reuses the entries
+  size_t cap = t.cap;
+  for (int round = 0; round < 8; round++) {
+    for (int i = 0; i < size; i += 2) {
+      bool b = false;
+      test_remove(&t, i, &b);
+      assert(b);
+      assert(test_insert(&t, i, i));
+    }
+  }
+  assert(t.cap == cap);
+  for (int i = 0; i < size; i++)
+    assert(*test_lookup(&t, i) == (i % 2 ? -i : i));
+
+  test_rehash(&t, t.cap);
+  assert(t.graves == 0 && t.used == t.len);
+  test_deinit(&t);
+
+  // string keys, the hashes are already kept with the entries
+  struct name_table s;
+  name_init(&s);
+  char buf[64][16];
+  for (int i = 0; i < 64; i++) {
+    snprintf(buf[i], sizeof(buf[i]), "k%d", i);
+    assert(name_insert(&s, buf[i], i));
+  }
+  for (int i = 0; i < 64; i++)
+    assert(*name_lookup(&s, buf[i]) == i);
+  n = 0;
+  ht_foreach(name, &s, k, v) assert(*v == n++);
+  assert(n == 64);
+  name_deinit(&s);
+}
@@ -0,0 +1,67 @@
+#include "../hash.h"
+
+struct key {
+  int a;
+  int b;
+};
+
+#define HT_KEY struct key
+#define HT_VAL int
+#define HT_PREFIX test
+#define HT_CTRL
+
+// no HT_KEY_EMPTY / HT_KEY_GRAVE, every key value is usable
+#define HT_KEY_EQ(i, j) ((i).a == (j).a && (i).b == (j).b)
+#define HT_KEY_HASH(i) (ds_hash_u32((i).a) ^ ds_hash_u32((i).b))
+
+#define HT_WANT_PRINT
+
+#include "../ht.h"
+
+int main() {
+  struct test_table t;
+  test_init(&t);
+  int size = 10000;
+
+  // check that we can insert values
+  for (int i = 0; i < size; i++)
+    assert(test_insert(&t, (struct key){.a = i - 1, .b = -i}, 1));
+  assert(t.len == size);
+
+  // duplicate inserts are refused
+  for (int i = 0; i < size; i++)
+    assert(!test_insert(&t, (struct key){.a = i - 1, .b = -i}, 3));
+
+  // check that we can remove values
+  for (int i = 0; i < size; i++) {
+    if (i % 2) {
+      bool b = false;
+      int pop = test_remove(&t, (struct key){.a = i - 1, .b = -i}, &b);
+      assert(b);
+      assert(pop == 1);
+    } else {
+      test_update(&t, (struct key){.a = i - 1, .b = -i}, 2);
+    }
+  }
+  assert(t.len == size / 2);
+
+  // check that only every other key is still there
+  for (int i = 0; i < size; i++) {
+    if (i % 2)
+      assert(!test_contains(&t, (struct key){.a = i - 1, .b = -i}));
+    else
+      assert(*test_lookup(&t, (struct key){.a = i - 1, .b = -i}) == 2);
+  }
+
+  // removed slots get reused
+  for (int i = 1; i < size; i += 2)
+    assert(test_insert(&t, (struct key){.a = i - 1, .b = -i}, 4));
+  for (int i = 0; i < size; i++)
+    assert(*test_lookup(&t, (struct key){.a = i - 1, .b = -i}) == (i % 2 ? 4 : 2));
+
+  test_rehash(&t, t.cap);
+  for (int i = 0; i < size; i++)
+    assert(test_contains(&t, (struct key){.a = i - 1, .b = -i}));
+
+  test_deinit(&t);
+}
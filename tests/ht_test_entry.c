@@ -0,0 +1,94 @@
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX test
+#define HT_KEY_ATOMIC
+
+#define HT_KEY_EMPTY -1
+#define HT_KEY_GRAVE -2
+
+#include "../ht.h"
+
+#define HT_KEY int
+#define HT_VAL long
+#define HT_PREFIX inc
+#define HT_KEY_ATOMIC
+#define HT_INCREMENTAL
+#define HT_MIGRATE_STEP 2
+
+#define HT_KEY_EMPTY -1
+#define HT_KEY_GRAVE -2
+
+#include "../ht.h"
+
+#define HT_VAL int
+#define HT_PREFIX word
+#define HT_KEY_STR
+#define HT_KEY_LEN 8
+#define HT_COMPACT
+
+#include "../ht.h"
+
+int main() {
+  struct test_table t;
+  test_init(&t);
+  int size = 10000;
+
+  // counting: every key is seen three times
+  for (int r = 0; r < 3; r++) {
+    for (int i = 0; i < size; i++) {
+      bool new;
+      int* v = test_entry(&t, i, &new);
+      assert(new == (r == 0));
+      if (new)
+        *v = 0;
+      (*v)++;
+    }
+  }
+  assert(t.len == size);
+  for (int i = 0; i < size; i++)
+    assert(*test_lookup(&t, i) == 3);
+
+  // the table grows before the key is placed, the pointer is still good
+  for (int i = size;; i++) {
+    size_t cap = t.cap;
+    bool new;
+    int* v = test_entry(&t, i, &new);
+    *v = i;
+    if (t.cap != cap) {
+      assert(test_lookup(&t, i) == v);
+      break;
+    }
+  }
+
+  // entry does a single search, lookup + update two
+  size_t len = t.len;
+  *test_get_or_insert(&t, -5, 7) += 1;
+  *test_get_or_insert(&t, -5, 7) += 1;
+  assert(*test_lookup(&t, -5) == 9);
+  assert(t.len == len + 1);
+  test_deinit(&t);
+
+  struct inc_table c;
+  inc_init(&c);
+  for (int r = 0; r < 2; r++)
+    for (int i = 0; i < size; i++)
+      *inc_get_or_insert(&c, i % 1000, 0) += i;
+  for (int i = 0; i < 1000; i++) {
+    long sum = 0;
+    for (int j = i; j < size; j += 1000)
+      sum += 2 * j;
+    assert(*inc_lookup(&c, i) == sum);
+  }
+  assert(c.len == 1000);
+  inc_deinit(&c);
+
+  struct word_table w;
+  word_init(&w);
+  word_str text[] = {"a", "b", "a", "c", "b", "a"};
+  for (int i = 0; i < 6; i++)
+    (*word_get_or_insert(&w, text[i], 0))++;
+  assert(*word_lookup(&w, text[0]) == 3);
+  assert(*word_lookup(&w, text[1]) == 2);
+  assert(*word_lookup(&w, text[3]) == 1);
+  word_deinit(&w);
+}
@@ -0,0 +1,77 @@
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX test
+#define HT_KEY_ATOMIC
+#define HT_INCREMENTAL
+#define HT_MIGRATE_STEP 4
+
+#define HT_KEY_EMPTY -1
+#define HT_KEY_GRAVE -2
+
+#include "../ht.h"
+
+int main() {
+  struct test_table t;
+  test_init(&t);
+  int size = 10000;
+  bool migrated = false;
+
+  // check that we can insert values and see all of them while migrating
+  for (int i = 0; i < size; i++) {
+    assert(test_insert(&t, i, 1));
+    assert(!test_insert(&t, i / 2, 1));
+    if (t.okeys) {
+      migrated = true;
+      assert(test_contains(&t, 0));
+      assert(*test_lookup(&t, i / 3) == 1);
+    }
+  }
+  assert(migrated);
+  assert(t.len == size);
+
+  // iterating while migrating sees every pair exactly once
+  int extra = size;
+  while (!t.okeys)
+    test_insert(&t, extra++, 1);
+  char* seen = calloc(extra, 1);
+  size_t n = 0;
+  ht_foreach(test, &t, k, v) {
+    assert(!seen[*k]);
+    seen[*k] = 1;
+    n++;
+  }
+  assert(n == t.len);
+  free(seen);
+  for (int i = size; i < extra; i++)
+    test_remove(&t, i, &migrated);
+  assert(t.len == size);
+
+  // check that we can remove values
+  for (int i = 0; i < size; i++) {
+    if (i % 2) {
+      bool b = false;
+      int pop = test_remove(&t, i, &b);
+      assert(b);
+      assert(pop == 1);
+    } else {
+      test_update(&t, i, 2);
+    }
+  }
+  assert(t.len == size / 2);
+
+  // check that only every other key is still there
+  for (int i = 0; i < size; i++)
+    if (i % 2)
+      assert(!test_contains(&t, i));
+    else
+      assert(*test_lookup(&t, i) == 2);
+
+  // synchronous rehash finishes a running migration
+  test_rehash(&t, t.cap);
+  assert(!t.okeys);
+  assert(t.graves == 0);
+  for (int i = 0; i < size; i += 2)
+    assert(*test_lookup(&t, i) == 2);
+
+  test_deinit(&t);
+}
@@ -0,0 +1,116 @@
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX test
+#define HT_KEY_ATOMIC
+#define HT_LAYOUT_INLINE
+
+#define HT_KEY_EMPTY -1
+#define HT_KEY_GRAVE -2
+
+#include "../ht.h"
+
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX ctrl
+#define HT_KEY_ATOMIC
+#define HT_CTRL
+#define HT_LAYOUT_INLINE
+
+#include "../ht.h"
+
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX rh
+#define HT_KEY_ATOMIC
+#define HT_ROBIN_HOOD
+#define HT_LAYOUT_INLINE
+
+#define HT_KEY_EMPTY -1
+
+#include "../ht.h"
+
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX inc
+#define HT_KEY_ATOMIC
+#define HT_INCREMENTAL
+#define HT_MIGRATE_STEP 2
+#define HT_LAYOUT_INLINE
+
+#define HT_KEY_EMPTY -1
+#define HT_KEY_GRAVE -2
+
+#include "../ht.h"
+
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX cmp
+#define HT_KEY_ATOMIC
+#define HT_COMPACT
+#define HT_LAYOUT_INLINE
+
+#include "../ht.h"
+
+#define HT_VAL long
+#define HT_PREFIX word
+#define HT_KEY_STR
+#define HT_KEY_LEN 8
+#define HT_LAYOUT_INLINE
+
+#include "../ht.h"
+
+#include <stddef.h>
+
+#define CHECK_INLINE(prefix)                                                   \
+  do {                                                                         \
+    struct prefix##_table t;                                                   \
+    prefix##_init(&t);                                                         \
+    int size = 20000;                                                          \
+    for (int i = 0; i < size; i++)                                             \
+      assert(prefix##_insert(&t, i, i * 2));                                   \
+    for (int i = 0; i < size; i++)                                             \
+      assert(*prefix##_lookup(&t, i) == i * 2);                                \
+                                                                               \
+    bool b = false;                                                            \
+    for (int i = 0; i < size; i += 2)                                          \
+      assert(prefix##_remove(&t, i, &b) == i * 2 && b);                        \
+    for (int i = 0; i < size; i++)                                             \
+      if (i % 2)                                                               \
+        assert(*prefix##_lookup(&t, i) == i * 2);                              \
+      else                                                                     \
+        assert(!prefix##_lookup(&t, i));                                       \
+    for (int i = 1; i < size; i += 2)                                          \
+      prefix##_update(&t, i, -i);                                              \
+                                                                               \
+    size_t n = 0;                                                              \
+    ht_foreach(prefix, &t, k, v) {                                             \
+      assert(*v == -*k);                                                       \
+      /* the value sits right behind its key */                                \
+      assert((char*)v - (char*)k == offsetof(struct prefix##_slot, v));        \
+      n++;                                                                     \
+    }                                                                          \
+    assert(n == t.len && n == (size_t)size / 2);                               \
+    prefix##_shrink_to_fit(&t);                                                \
+    for (int i = 1; i < size; i += 2)                                          \
+      assert(*prefix##_lookup(&t, i) == -i);                                   \
+    prefix##_deinit(&t);                                                       \
+  } while (0)
+
+int main() {
+  CHECK_INLINE(test);
+  CHECK_INLINE(ctrl);
+  CHECK_INLINE(rh);
+  CHECK_INLINE(inc);
+  CHECK_INLINE(cmp);
+
+  struct word_table w;
+  word_init(&w);
+  char words[][8] = {"apple", "pear", "plum"};
+  for (int i = 0; i < 3; i++)
+    assert(word_insert(&w, words[i], i));
+  for (int i = 0; i < 3; i++)
+    assert(*word_lookup(&w, words[i]) == i);
+  assert(!word_insert(&w, words[1], 9));
+  assert(*word_lookup(&w, words[1]) == 1);
+  word_deinit(&w);
+}
@@ -0,0 +1,43 @@
+#include <stdio.h>
+
+#define HT_KEY char*
+#define HT_VAL int
+#define HT_PREFIX test
+#define HT_KEY_MEM
+#define KEY_LEN 24
+#define HT_KEY_LEN KEY_LEN
+#define HT_FAST_HASH
+#define HT_HASH_SEED 42
+#define HT_CTRL // pointer keys don't have spare sentinel values
+
+#include "../ht.h"
+
+int main() {
+  struct test_table t;
+  test_init(&t);
+  int size = 1000;
+  char(*a)[KEY_LEN] = calloc(size, KEY_LEN);
+  char(*b)[KEY_LEN] = calloc(size, KEY_LEN);
+
+  // two copies of every key in different memory
+  for (int i = 0; i < size; i++) {
+    snprintf(a[i], KEY_LEN, "key number %d", i);
+    memcpy(b[i], a[i], KEY_LEN);
+  }
+
+  for (int i = 0; i < size; i++)
+    assert(test_insert(&t, a[i], i));
+
+  // keys are compared and hashed by content
+  for (int i = 0; i < size; i++) {
+    assert(!test_insert(&t, b[i], i));
+    assert(*test_lookup(&t, b[i]) == i);
+  }
+
+  b[0][KEY_LEN - 1] = 'x';
+  assert(!test_contains(&t, b[0]));
+
+  test_deinit(&t);
+  free(a);
+  free(b);
+}
@@ -0,0 +1,73 @@
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX test
+#define HT_KEY_ATOMIC
+#define HT_ROBIN_HOOD
+#define HT_MAX_DENSITY 0.9 // no empty key needed, slots are marked by hashes
+
+#include "../ht.h"
+
+// keys in each run have to be ordered by their home slot, and every used slot
+// holds the hash of its key
+void check_order(struct test_table* t) {
+  for (size_t i = 0; i < t->cap; i++) {
+    size_t j = (i + 1) & (t->cap - 1);
+    if (t->hashes[i])
+      assert(t->hashes[i] == test__hash(t->keys[i]));
+    if (t->hashes[i] && t->hashes[j])
+      assert(test__dist(t, j) <= test__dist(t, i) + 1);
+  }
+}
+
+int main() {
+  struct test_table t;
+  test_init(&t);
+  int size = 10000;
+
+  // check that we can insert values
+  for (int i = 0; i < size; i++)
+    assert(test_insert(&t, i, 1));
+  check_order(&t);
+
+  // churn: remove and reinsert, graves must never appear
+  for (int round = 0; round < 4; round++) {
+    for (int i = round % 2; i < size; i += 2) {
+      bool b = false;
+      assert(test_remove(&t, i, &b) == 1);
+      assert(b);
+    }
+    assert(t.graves == 0);
+    assert(t.len == size / 2);
+    check_order(&t);
+    for (int i = round % 2; i < size; i += 2)
+      assert(!test_contains(&t, i));
+    for (int i = round % 2; i < size; i += 2)
+      assert(test_insert(&t, i, 1));
+  }
+
+  // check that we can remove values
+  for (int i = 0; i < size; i++) {
+    if (i % 2) {
+      bool b = false;
+      int pop = test_remove(&t, i, &b);
+      assert(b);
+      assert(pop == 1);
+    } else {
+      test_update(&t, i, 2);
+    }
+  }
+
+  // check that only every other key is still there
+  for (int i = 0; i < size; i++)
+    if (i % 2)
+      assert(!test_contains(&t, i));
+    else
+      assert(*test_lookup(&t, i) == 2);
+
+  test_rehash(&t, t.cap);
+  check_order(&t);
+  for (int i = 0; i < size; i += 2)
+    assert(*test_lookup(&t, i) == 2);
+
+  test_deinit(&t);
+}
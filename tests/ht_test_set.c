@@ -0,0 +1,120 @@
+#define HT_KEY u64
+#define HT_PREFIX set
+#define HT_KEY_ATOMIC
+
+#define HT_KEY_EMPTY 0
+#define HT_KEY_GRAVE 1
+
+#include "../ht.h"
+
+#define HT_KEY u64
+#define HT_PREFIX ctrl
+#define HT_KEY_ATOMIC
+#define HT_CTRL
+
+#include "../ht.h"
+
+#define HT_KEY u64
+#define HT_PREFIX rh
+#define HT_KEY_ATOMIC
+#define HT_ROBIN_HOOD
+
+#define HT_KEY_EMPTY 0
+
+#include "../ht.h"
+
+#define HT_KEY u64
+#define HT_PREFIX inc
+#define HT_KEY_ATOMIC
+#define HT_INCREMENTAL
+#define HT_MIGRATE_STEP 2
+
+#define HT_KEY_EMPTY 0
+#define HT_KEY_GRAVE 1
+
+#include "../ht.h"
+
+#define HT_KEY u64
+#define HT_PREFIX cmp
+#define HT_KEY_ATOMIC
+#define HT_COMPACT
+
+#include "../ht.h"
+
+#define HT_PREFIX word
+#define HT_KEY_STR
+#define HT_KEY_LEN 8
+
+#include "../ht.h"
+
+// keys 2, 3, ... stay clear of the empty and grave markers
+#define CHECK_SET(prefix)                                                      \
+  do {                                                                         \
+    struct prefix##_table t;                                                   \
+    prefix##_init(&t);                                                         \
+    u64 size = 20000;                                                          \
+    for (u64 i = 2; i < size; i++)                                             \
+      assert(prefix##_add(&t, i));                                             \
+    for (u64 i = 2; i < size; i++)                                             \
+      assert(!prefix##_add(&t, i));                                            \
+    assert(t.len == size - 2);                                                 \
+    for (u64 i = 2; i < size; i++)                                             \
+      assert(prefix##_contains(&t, i));                                        \
+    assert(!prefix##_contains(&t, size));                                      \
+                                                                               \
+    u64 sum = 0;                                                               \
+    size_t n = 0;                                                              \
+    ht_foreach_key(prefix, &t, k) {                                            \
+      sum += *k;                                                               \
+      n++;                                                                     \
+    }                                                                          \
+    assert(n == t.len);                                                        \
+    assert(sum == (u64)size * (size - 1) / 2 - 1);                             \
+                                                                               \
+    for (u64 i = 2; i < size; i += 2)                                          \
+      assert(prefix##_remove(&t, i));                                          \
+    assert(!prefix##_remove(&t, 2));                                           \
+    for (u64 i = 2; i < size; i++)                                             \
+      assert(prefix##_contains(&t, i) == (i % 2));                             \
+                                                                               \
+    u64 keys[64];                                                              \
+    bool out[64];                                                              \
+    for (int i = 0; i < 64; i++)                                               \
+      keys[i] = size + i / 2;                                                  \
+    assert(prefix##_add_batch(&t, 64, keys) == 32);                            \
+    prefix##_contains_batch(&t, 64, keys, out);                                \
+    for (int i = 0; i < 64; i++)                                               \
+      assert(out[i]);                                                          \
+    prefix##_deinit(&t);                                                       \
+                                                                               \
+    u64* ks = malloc(sizeof(u64) * size);                                      \
+    for (u64 i = 0; i < size; i++)                                             \
+      ks[i] = 2 + (i * 7919) % (size / 2);                                     \
+    prefix##_build(&t, size, ks);                                              \
+    assert(t.len == size / 2);                                                 \
+    for (u64 i = 0; i < size; i++)                                             \
+      assert(prefix##_contains(&t, ks[i]));                                    \
+    prefix##_deinit(&t);                                                       \
+    free(ks);                                                                  \
+  } while (0)
+
+int main() {
+  CHECK_SET(set);
+  CHECK_SET(ctrl);
+  CHECK_SET(rh);
+  CHECK_SET(inc);
+  CHECK_SET(cmp);
+
+  struct word_table w;
+  word_init(&w);
+  char words[][8] = {"apple", "pear", "plum", "apple"};
+  assert(word_add(&w, words[0]));
+  assert(word_add(&w, words[1]));
+  assert(word_add(&w, words[2]));
+  assert(!word_add(&w, words[3]));
+  assert(word_contains(&w, words[3]));
+  assert(word_remove(&w, words[1]));
+  assert(!word_contains(&w, words[1]));
+  assert(w.len == 2);
+  word_deinit(&w);
+}
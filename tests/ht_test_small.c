@@ -0,0 +1,183 @@
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX test
+#define HT_KEY_ATOMIC
+#define HT_SMALL 4
+
+#define HT_KEY_EMPTY -1
+#define HT_KEY_GRAVE -2
+
+#include "../ht.h"
+
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX ctrl
+#define HT_KEY_ATOMIC
+#define HT_CTRL
+#define HT_SMALL 4
+
+#include "../ht.h"
+
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX rh
+#define HT_KEY_ATOMIC
+#define HT_ROBIN_HOOD
+#define HT_SMALL 4
+
+#define HT_KEY_EMPTY -1
+
+#include "../ht.h"
+
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX inc
+#define HT_KEY_ATOMIC
+#define HT_INCREMENTAL
+#define HT_MIGRATE_STEP 2
+#define HT_SMALL 4
+
+#define HT_KEY_EMPTY -1
+#define HT_KEY_GRAVE -2
+
+#include "../ht.h"
+
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX cmp
+#define HT_KEY_ATOMIC
+#define HT_COMPACT
+#define HT_SMALL 4
+
+#include "../ht.h"
+
+#define HT_KEY u32
+#define HT_PREFIX set
+#define HT_KEY_ATOMIC
+#define HT_SMALL 8
+#define HT_SIZE u32
+
+#define HT_KEY_EMPTY 0
+#define HT_KEY_GRAVE 1
+
+#include "../ht.h"
+
+#define HT_VAL long
+#define HT_PREFIX word
+#define HT_KEY_STR
+#define HT_KEY_LEN 8
+#define HT_SMALL 2
+
+#include "../ht.h"
+
+#define HT_KEY u64
+#define HT_VAL u64
+#define HT_PREFIX narrow
+#define HT_KEY_ATOMIC
+#define HT_SIZE u32
+
+#define HT_KEY_EMPTY 0
+#define HT_KEY_GRAVE 1
+
+#include "../ht.h"
+
+#define CHECK_SMALL(prefix)                                                    \
+  do {                                                                         \
+    struct prefix##_table t;                                                   \
+    prefix##_init(&t);                                                         \
+    /* up to HT_SMALL pairs stay inline */                                     \
+    for (int i = 0; i < 4; i++)                                                \
+      assert(prefix##_insert(&t, i, i * 2));                                   \
+    assert(!prefix##_insert(&t, 2, 0));                                        \
+    assert(t.cap == 0 && t.len == 4);                                          \
+    for (int i = 0; i < 4; i++)                                                \
+      assert(*prefix##_lookup(&t, i) == i * 2);                                \
+    assert(!prefix##_lookup(&t, 4));                                           \
+                                                                               \
+    bool b = false;                                                            \
+    assert(prefix##_remove(&t, 1, &b) == 2 && b);                              \
+    prefix##_remove(&t, 1, &b);                                                \
+    assert(!b && t.len == 3 && !prefix##_contains(&t, 1));                     \
+    prefix##_update(&t, 3, 7);                                                 \
+    bool new;                                                                  \
+    *prefix##_entry(&t, 9, &new) = 18;                                         \
+    assert(new && *prefix##_get_or_insert(&t, 9, 0) == 18);                    \
+    assert(t.cap == 0 && t.len == 4);                                          \
+                                                                               \
+    /* the fifth pair spills into the containers */                            \
+    int size = 10000;                                                          \
+    for (int i = 10; i < size; i++)                                            \
+      assert(prefix##_insert(&t, i, i * 2));                                   \
+    assert(t.cap > 0 && t.len == (size_t)size - 6);                            \
+    assert(*prefix##_lookup(&t, 3) == 7 && *prefix##_lookup(&t, 9) == 18);     \
+    for (int i = 10; i < size; i++)                                            \
+      assert(*prefix##_lookup(&t, i) == i * 2);                                \
+                                                                               \
+    for (int i = 10; i < size; i++)                                            \
+      prefix##_remove(&t, i, &b);                                              \
+    prefix##_shrink_to_fit(&t);                                                \
+    assert(t.cap == 0 && t.len == 4);                                          \
+    int sum = 0;                                                               \
+    ht_foreach(prefix, &t, k, v) {                                             \
+      assert(*prefix##_lookup(&t, *k) == *v);                                  \
+      sum += *v;                                                               \
+    }                                                                          \
+    assert(sum == 0 + 4 + 7 + 18);                                             \
+                                                                               \
+    prefix##_reserve(&t, 100);                                                 \
+    assert(t.cap > 0 && *prefix##_lookup(&t, 2) == 4);                         \
+    prefix##_deinit(&t);                                                       \
+                                                                               \
+    int keys[] = {5, 6, 5, 7};                                                 \
+    int vals[] = {1, 2, 3, 4};                                                 \
+    int* out[4];                                                               \
+    prefix##_build(&t, 4, keys, vals);                                         \
+    assert(t.cap == 0 && t.len == 3);                                          \
+    prefix##_lookup_batch(&t, 4, keys, out);                                   \
+    assert(*out[0] == 1 && *out[1] == 2 && *out[2] == 1 && *out[3] == 4);      \
+    prefix##_deinit(&t);                                                       \
+  } while (0)
+
+int main() {
+  CHECK_SMALL(test);
+  CHECK_SMALL(ctrl);
+  CHECK_SMALL(rh);
+  CHECK_SMALL(inc);
+  CHECK_SMALL(cmp);
+
+  struct set_table s;
+  set_init(&s);
+  u32 keys[20];
+  bool out[20];
+  for (u32 i = 0; i < 20; i++)
+    keys[i] = 2 + i % 10;
+  assert(set_add_batch(&s, 6, keys) == 6 && s.cap == 0);
+  assert(set_add_batch(&s, 20, keys) == 4 && s.cap > 0);
+  set_contains_batch(&s, 20, keys, out);
+  for (int i = 0; i < 20; i++)
+    assert(out[i]);
+  assert(set_remove(&s, 2) && set_remove(&s, 3) && !set_remove(&s, 2));
+  set_shrink_to_fit(&s);
+  assert(s.cap == 0 && s.len == 8 && set_contains(&s, 11));
+  set_deinit(&s);
+
+  struct word_table w;
+  word_init(&w);
+  char words[][8] = {"apple", "pear", "plum"};
+  assert(word_insert(&w, words[0], 0) && word_insert(&w, words[1], 1));
+  assert(!word_insert(&w, words[1], 9) && w.cap == 0);
+  assert(word_insert(&w, words[2], 2) && w.cap > 0);
+  for (int i = 0; i < 3; i++)
+    assert(*word_lookup(&w, words[i]) == i);
+  word_deinit(&w);
+
+  // 32-bit sizes shrink the table struct
+  assert(sizeof(struct narrow_table) == 32);
+  struct narrow_table n;
+  narrow_init(&n);
+  for (u64 i = 2; i < 100000; i++)
+    narrow_insert(&n, i, i);
+  for (u64 i = 2; i < 100000; i++)
+    assert(*narrow_lookup(&n, i) == i);
+  narrow_deinit(&n);
+}
@@ -0,0 +1,148 @@
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX test
+#define HT_KEY_ATOMIC
+#define HT_WANT_SNAPSHOT
+
+#define HT_KEY_EMPTY -1
+#define HT_KEY_GRAVE -2
+
+#include "../ht.h"
+
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX ctrl
+#define HT_KEY_ATOMIC
+#define HT_CTRL
+#define HT_WANT_SNAPSHOT
+
+#include "../ht.h"
+
+#define HT_VAL long
+#define HT_PREFIX name
+#define HT_KEY_STR
+#define HT_KEY_LEN 16
+#define HT_COMPACT
+#define HT_WANT_SNAPSHOT
+
+#include "../ht.h"
+
+#define HT_KEY int
+#define HT_PREFIX set
+#define HT_KEY_ATOMIC
+#define HT_WANT_SNAPSHOT
+
+#define HT_KEY_EMPTY -1
+#define HT_KEY_GRAVE -2
+
+#include "../ht.h"
+
+#include <stdio.h>
+
+int main() {
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/ht_test_snapshot.%d", (int)getpid());
+  int size = 100000;
+
+  struct test_table t;
+  test_init(&t);
+  for (int i = 0; i < size; i++)
+    test_insert(&t, i, i * 3);
+  bool b = false;
+  for (int i = 0; i < size; i += 7)
+    test_remove(&t, i, &b);
+  assert(test_save(&t, path));
+
+  struct test_table l;
+  assert(test_load_mmap(&l, path));
+  assert(l.len == t.len && l.cap == t.cap && l.graves == t.graves);
+  for (int i = 0; i < size; i++)
+    if (i % 7)
+      assert(*test_lookup(&l, i) == i * 3);
+    else
+      assert(!test_contains(&l, i));
+  size_t n = 0;
+  ht_foreach(test, &l, k, v) {
+    assert(*v == *k * 3);
+    n++;
+  }
+  assert(n == l.len);
+  test_deinit(&l);
+  test_deinit(&t);
+
+  // a table with another layout can't load it
+  struct ctrl_table c;
+  assert(!ctrl_load_mmap(&c, path));
+  ctrl_init(&c);
+  for (int i = 0; i < size; i++)
+    ctrl_insert(&c, i, -i);
+  assert(ctrl_save(&c, path));
+  ctrl_deinit(&c);
+  assert(ctrl_load_mmap(&c, path));
+  for (int i = 0; i < size; i++)
+    assert(*ctrl_lookup(&c, i) == -i);
+  assert(!ctrl_contains(&c, size));
+  ctrl_deinit(&c);
+
+  // headers that don't match the file fail and leave the table alone
+  struct ctrl__snap h;
+  int fd = open(path, O_RDWR);
+  assert(pread(fd, &h, sizeof(h), 0) == sizeof(h));
+  struct ctrl__snap bad[] = {h, h, h, h, h, h};
+  bad[0].cap = h.cap * 2;
+  bad[1].cap = 1ull << 62;
+  bad[2].len = h.cap;
+  bad[3].len = UINT64_MAX;
+  bad[4].graves = h.cap - h.len;
+  bad[5].graves = UINT64_MAX;
+  for (int i = 0; i < 6; i++) {
+    assert(pwrite(fd, &bad[i], sizeof(h), 0) == sizeof(h));
+    struct ctrl_table before;
+    memset(&c, 0xab, sizeof(c));
+    before = c;
+    assert(!ctrl_load_mmap(&c, path) && !memcmp(&c, &before, sizeof(c)));
+  }
+  assert(pwrite(fd, &h, sizeof(h), 0) == sizeof(h));
+  close(fd);
+  assert(ctrl_load_mmap(&c, path));
+  ctrl_deinit(&c);
+
+  // truncated file
+  assert(truncate(path, 100) == 0);
+  assert(!ctrl_load_mmap(&c, path));
+  assert(!test_load_mmap(&t, "/nonexistent/ht_test_snapshot"));
+
+  // inline string keys
+  struct name_table s;
+  name_init(&s);
+  char key[16];
+  for (int i = 0; i < 1000; i++) {
+    snprintf(key, sizeof(key), "key%d", i);
+    name_insert(&s, key, i);
+  }
+  assert(name_save(&s, path));
+  name_deinit(&s);
+  assert(name_load_mmap(&s, path));
+  for (int i = 0; i < 1000; i++) {
+    snprintf(key, sizeof(key), "key%d", i);
+    assert(*name_lookup(&s, key) == i);
+  }
+  long order = 0;
+  ht_foreach(name, &s, k, v) assert(*v == order++);
+  name_deinit(&s);
+
+  // sets have no values in the file
+  struct set_table st;
+  set_init(&st);
+  for (int i = 0; i < size; i += 3)
+    set_add(&st, i);
+  assert(set_save(&st, path));
+  set_deinit(&st);
+  assert(!test_load_mmap(&t, path));
+  assert(set_load_mmap(&st, path));
+  for (int i = 0; i < size; i++)
+    assert(set_contains(&st, i) == (i % 3 == 0));
+  set_deinit(&st);
+
+  unlink(path);
+}
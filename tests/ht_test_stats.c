@@ -0,0 +1,91 @@
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX test
+#define HT_KEY_ATOMIC
+#define HT_WANT_STATS
+
+#define HT_KEY_EMPTY -1
+#define HT_KEY_GRAVE -2
+
+#include "../ht.h"
+
+// every 64 consecutive keys collide
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX bad
+#define HT_KEY_EQ(a, b) ((a) == (b))
+#define HT_KEY_HASH(a) ((uint)(a) / 64)
+#define HT_CACHE_HASH
+#define HT_WANT_STATS
+
+#include "../ht.h"
+
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX ctrl
+#define HT_KEY_ATOMIC
+#define HT_CTRL
+#define HT_WANT_STATS
+
+#include "../ht.h"
+
+int main() {
+  struct test_table t;
+  test_init(&t);
+  int size = 10000;
+
+  for (int i = 0; i < size; i++)
+    test_insert(&t, i, i);
+  // an insert that grows the table searches again after the rehash
+  size_t grown = t.counters.rehashes;
+  assert(grown > 0);
+  assert(t.counters.lookups == size + grown);
+  assert(t.counters.misses == size + grown);
+  assert(t.counters.probes >= size);
+
+  for (int i = 0; i < 2 * size; i++)
+    test_contains(&t, i);
+  assert(t.counters.lookups == 3 * size + grown);
+  assert(t.counters.misses == 2 * size + grown);
+
+  bool b;
+  for (int i = 0; i < size; i += 4)
+    test_remove(&t, i, &b);
+  assert(t.counters.graves == size / 4);
+
+  struct test_stats s;
+  test_stats(&t, &s);
+  assert(s.len == t.len && s.cap == t.cap && s.graves == t.graves);
+  assert(s.counters.lookups == t.counters.lookups);
+  size_t n = 0;
+  for (int i = 0; i < (int)(sizeof(s.hist) / sizeof(*s.hist)); i++)
+    n += s.hist[i];
+  assert(n == t.len);
+  assert(s.hist[0] > t.len / 2);
+  assert(s.mean_dist < 2 * s.expected_dist + 0.5);
+  assert(s.clusters > 0 && s.max_cluster >= s.mean_cluster);
+  test_deinit(&t);
+
+  // a bad hash shows up as a mean distance far above the expected one
+  struct bad_table w;
+  bad_init(&w);
+  for (int i = 0; i < size; i++)
+    bad_insert(&w, i, i);
+  struct bad_stats ws;
+  bad_stats(&w, &ws);
+  assert(ws.mean_dist > 10 * ws.expected_dist);
+  assert(ws.max_dist >= 63);
+  assert(ws.counters.probes > 10 * ws.counters.lookups);
+  bad_deinit(&w);
+
+  // distances are in groups with HT_CTRL
+  struct ctrl_table c;
+  ctrl_init(&c);
+  for (int i = 0; i < size; i++)
+    ctrl_insert(&c, i, i);
+  struct ctrl_stats cs;
+  ctrl_stats(&c, &cs);
+  assert(cs.hist[0] > cs.len * 9 / 10);
+  assert(cs.expected_dist == 0);
+  ctrl_deinit(&c);
+}
@@ -0,0 +1,79 @@
+#include <stdio.h>
+
+#define HT_VAL int
+#define HT_PREFIX sp
+#define HT_KEY_STRPTR
+#define HT_WANT_PRINT
+#include "../ht.h"
+
+#define HT_VAL int
+#define HT_PREFIX sa
+#define HT_KEY_STR
+#define HT_KEY_LEN 8
+#define HT_FAST_HASH
+#include "../ht.h"
+
+void test_strptr(int size) {
+  struct sp_table t;
+  sp_init(&t);
+  char(*a)[32] = calloc(size, 32);
+  char b[32];
+
+  for (int i = 0; i < size; i++) {
+    snprintf(a[i], 32, "identifier_%d", i);
+    assert(sp_insert(&t, a[i], i));
+  }
+
+  // keys are compared by content, the hash is stored next to them
+  for (int i = 0; i < size; i++) {
+    snprintf(b, 32, "identifier_%d", i);
+    assert(!sp_insert(&t, b, 0));
+    assert(*sp_lookup(&t, b) == i);
+    assert(t.hashes[(size_t)(sp__hash(b) & (t.cap - 1))] > 1);
+  }
+
+  for (int i = 0; i < size; i += 2) {
+    bool found = false;
+    assert(sp_remove(&t, a[i], &found) == i);
+    assert(found);
+  }
+  for (int i = 0; i < size; i++)
+    assert(sp_contains(&t, a[i]) == (i % 2));
+  assert(t.len == size / 2);
+
+  sp_rehash(&t, t.cap);
+  assert(t.graves == 0);
+  for (int i = 1; i < size; i += 2)
+    assert(*sp_lookup(&t, a[i]) == i);
+
+  sp_deinit(&t);
+  free(a);
+}
+
+void test_str(int size) {
+  struct sa_table t;
+  sa_init(&t);
+  char b[32];
+
+  // keys are copied into the table and cut to HT_KEY_LEN
+  for (int i = 0; i < size; i++) {
+    snprintf(b, 32, "k%d", i);
+    assert(sa_insert(&t, b, i));
+  }
+  snprintf(b, 32, "k%d", 0);
+  assert(!sa_insert(&t, b, 0));
+  assert(sa_insert(&t, "12345678", 1));
+  assert(*sa_lookup(&t, "123456789") == 1);
+
+  for (int i = 0; i < size; i++) {
+    snprintf(b, 32, "k%d", i);
+    assert(*sa_lookup(&t, b) == i);
+  }
+
+  sa_deinit(&t);
+}
+
+int main() {
+  test_strptr(1000);
+  test_str(1000);
+}
@@ -0,0 +1,101 @@
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX test
+#define HT_KEY_ATOMIC
+#define HT_MIN_DENSITY 0.125
+
+#include "../htb.h"
+
+#define HT_KEY u64
+#define HT_VAL u64
+#define HT_PREFIX wide
+#define HT_KEY_ATOMIC
+#define HT_BUCKET 7
+#define HT_MAX_DENSITY 0.95
+
+#include "../htb.h"
+
+#define HT_KEY char*
+#define HT_VAL int
+#define HT_PREFIX mem
+#define HT_KEY_MEM
+#define HT_KEY_LEN 8
+
+#include "../htb.h"
+
+int main() {
+  // int keys and values fit a bucket in a cache line, u64 ones at 7 don't
+  _Static_assert(sizeof(struct test_bucket) == 64, "one line per bucket");
+  _Static_assert(sizeof(struct wide_bucket) > 64, "wide buckets span lines");
+
+  struct test_table t;
+  test_init(&t);
+  assert((uintptr_t)t.buckets % 64 == 0);
+  int size = 100000;
+
+  // 0 is an ordinary key, there are no special keys
+  for (int i = 0; i < size; i++)
+    assert(test_insert(&t, i, i * 2));
+  assert(!test_insert(&t, 5, 0));
+  assert(t.len == size);
+  for (int i = 0; i < size; i++)
+    assert(*test_lookup(&t, i) == i * 2);
+  assert(!test_lookup(&t, size));
+  assert(t.len <= 0.9 * t.cap * 4);
+  assert((uintptr_t)t.buckets % 64 == 0); // after growing too
+
+  bool b = false;
+  for (int i = 0; i < size; i += 2)
+    assert(test_remove(&t, i, &b) == i * 2 && b);
+  test_remove(&t, 0, &b);
+  assert(!b);
+  for (int i = 1; i < size; i += 2)
+    test_update(&t, i, -i);
+  for (int i = 0; i < size; i++)
+    assert(test_contains(&t, i) == (i % 2));
+
+  size_t n = 0;
+  ht_foreach(test, &t, k, v) {
+    assert(*v == -*k);
+    n++;
+  }
+  assert(n == t.len);
+
+  // removing most of the keys shrinks the table
+  size_t cap = t.cap;
+  for (int i = 1; i < size; i += 2)
+    if (i % 99 != 1)
+      test_remove(&t, i, &b);
+  assert(t.cap < cap / 4);
+  for (int i = 1; i < size; i += 2)
+    assert(test_contains(&t, i) == (i % 99 == 1));
+  test_deinit(&t);
+
+  // fills the slots up to the density before growing
+  struct wide_table w;
+  wide_init(&w);
+  double peak = 0;
+  for (u64 i = 0; i < 1000000; i++) {
+    wide_insert(&w, i * 0x9e3779b97f4a7c15ull, i);
+    peak = ds_max(peak, (double)w.len / (w.cap * 7));
+  }
+  assert(peak > 0.9);
+  wide_reserve(&w, 3000000);
+  assert(w.cap * 7 * 0.95 >= 3000000);
+  for (u64 i = 0; i < 1000000; i++)
+    assert(*wide_lookup(&w, i * 0x9e3779b97f4a7c15ull) == i);
+  wide_deinit(&w);
+
+  struct mem_table m;
+  mem_init(&m);
+  char keys[1000][8] = {0};
+  for (int i = 0; i < 1000; i++) {
+    memcpy(keys[i], &i, sizeof(i));
+    assert(mem_insert(&m, keys[i], i));
+  }
+  char key[8] = {0};
+  int i = 123;
+  memcpy(key, &i, sizeof(i));
+  assert(*mem_lookup(&m, key) == 123);
+  mem_deinit(&m);
+}
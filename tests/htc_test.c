@@ -0,0 +1,103 @@
+// Also meant to be run built with -fsanitize=thread, which has to stay quiet.
+
+#include <pthread.h>
+
+#define HT_KEY int
+#define HT_VAL int
+#define HT_PREFIX test
+#define HT_KEY_ATOMIC
+#define HT_SHARDS 8
+
+#define HT_KEY_EMPTY -1
+#define HT_KEY_GRAVE -2
+
+#include "../htc.h"
+
+struct pair {
+  u64 a, b;
+};
+
+#define HT_KEY int
+#define HT_VAL struct pair
+#define HT_PREFIX wide
+#define HT_KEY_ATOMIC
+#define HT_SHARDS 1
+
+#define HT_KEY_EMPTY -1
+#define HT_KEY_GRAVE -2
+
+#include "../htc.h"
+
+#define THREADS 8
+#define PER_THREAD 20000
+
+struct test_table t;
+
+// every writer owns a range of keys, readers check keys of the other writers
+void* worker(void* arg) {
+  int id = (int)(intptr_t)arg;
+  int base = id * PER_THREAD;
+  for (int i = 0; i < PER_THREAD; i++) {
+    assert(test_insert(&t, base + i, i));
+    int v;
+    assert(test_lookup(&t, base + i, &v) && v == i);
+    // other threads' keys are either missing or have the right value
+    int o = ((id + 1) % THREADS) * PER_THREAD + i;
+    if (test_lookup(&t, o, &v))
+      assert(v == i || v == -i);
+  }
+  for (int i = 0; i < PER_THREAD; i += 2) {
+    bool b = false;
+    assert(test_remove(&t, base + i, &b) == i);
+    assert(b);
+    test_update(&t, base + i + 1, -(i + 1));
+  }
+  return NULL;
+}
+
+struct wide_table w;
+
+// values of two words are never seen half written
+void* wide_writer(void* arg) {
+  for (u64 i = 0; i < PER_THREAD; i++)
+    wide_update(&w, i % 16, (struct pair){i, i});
+  return NULL;
+}
+
+void* wide_reader(void* arg) {
+  struct pair p;
+  for (int i = 0; i < PER_THREAD; i++)
+    if (wide_lookup(&w, i % 16, &p))
+      assert(p.a == p.b);
+  return NULL;
+}
+
+int main() {
+  wide_init(&w);
+  pthread_t wr[2];
+  pthread_create(&wr[0], NULL, wide_writer, NULL);
+  pthread_create(&wr[1], NULL, wide_reader, NULL);
+  pthread_join(wr[0], NULL);
+  pthread_join(wr[1], NULL);
+  wide_deinit(&w);
+
+  test_init(&t);
+  pthread_t th[THREADS];
+
+  for (int i = 0; i < THREADS; i++)
+    pthread_create(&th[i], NULL, worker, (void*)(intptr_t)i);
+  for (int i = 0; i < THREADS; i++)
+    pthread_join(th[i], NULL);
+
+  assert(test_len(&t) == THREADS * PER_THREAD / 2);
+  for (int i = 0; i < THREADS * PER_THREAD; i++) {
+    int v;
+    int k = i % PER_THREAD;
+    if (k % 2)
+      assert(test_lookup(&t, i, &v) && v == -k);
+    else
+      assert(!test_contains(&t, i));
+  }
+
+  test_deinit(&t);
+}
@@ -0,0 +1,125 @@
+#include <stdio.h>
+
+#include "../intern.h"
+
+// intern.h's table leaves nothing behind for the ones generated after it
+#if defined(HT_TABLE_EXTRA_VARS) || defined(HT_FUNC_ATTR) ||                  \
+    defined(HT_KEY_EQ) || defined(HT_KEY_HASH) || defined(HT_ALLOC)
+#  error "intern.h leaks its ht.h macros"
+#endif
+
+// downstream table keyed by ids
+#define HT_KEY u32
+#define HT_VAL int
+#define HT_PREFIX count
+#define HT_KEY_ATOMIC
+
+#define HT_KEY_EMPTY DS_INTERN_NONE
+#define HT_KEY_GRAVE (DS_INTERN_NONE - 1)
+
+#include "../ht.h"
+
+int main() {
+  struct ds_intern in;
+  ds_intern_init(&in);
+  u32 foo = ds_intern(&in, "foo");
+  u32 bar = ds_intern(&in, "bar");
+  assert(foo == 0 && bar == 1 && in.len == 2);
+  char buf[] = "foobar";
+  assert(ds_intern_n(&in, buf, 3) == foo);
+  assert(ds_intern_n(&in, buf + 3, 3) == bar);
+  assert(ds_intern_find(&in, buf, 6) == DS_INTERN_NONE);
+  assert(ds_intern_find(&in, "bar", 3) == bar);
+  assert(ds_intern_str(&in, foo) != buf);
+  assert(!strcmp(ds_intern_str(&in, foo), "foo"));
+  assert(ds_intern_strlen(&in, bar) == 3);
+
+  // empty strings, embedded NULs, a long string
+  u32 empty = ds_intern(&in, "");
+  assert(ds_intern_n(&in, "a\0b", 3) != ds_intern_n(&in, "a\0c", 3));
+  assert(ds_intern_strlen(&in, empty) == 0);
+  assert(ds_intern_find(&in, "x", 0) == empty);
+  char* big = malloc(DS_INTERN_BLOCK * 2);
+  memset(big, 'z', DS_INTERN_BLOCK * 2 - 1);
+  big[DS_INTERN_BLOCK * 2 - 1] = 0;
+  u32 bigid = ds_intern(&in, big);
+  assert(!strcmp(ds_intern_str(&in, bigid), big));
+  free(big);
+
+  // many strings: stable ids and pointers while the table grows
+  size_t n = 50000;
+  u32* ids = malloc(sizeof(u32) * n);
+  const char** ptrs = malloc(sizeof(char*) * n);
+  char s[32];
+  for (size_t i = 0; i < n; i++) {
+    snprintf(s, sizeof(s), "ident_%zu", i);
+    ids[i] = ds_intern(&in, s);
+    ptrs[i] = ds_intern_str(&in, ids[i]);
+    assert(ids[i] == in.len - 1);
+  }
+  for (size_t i = 0; i < n; i++) {
+    snprintf(s, sizeof(s), "ident_%zu", i);
+    assert(ds_intern(&in, s) == ids[i]);
+    assert(ds_intern_str(&in, ids[i]) == ptrs[i] && !strcmp(ptrs[i], s));
+  }
+
+  // bulk: old strings, new ones and repeats within a batch
+  size_t m = 1000;
+  char(*words)[32] = malloc(32 * m);
+  const char** strs = malloc(sizeof(char*) * m);
+  u32* out = malloc(sizeof(u32) * m);
+  for (size_t i = 0; i < m; i++) {
+    snprintf(words[i], 32, i % 2 ? "ident_%zu" : "new_%zu", i / 4 * 4);
+    strs[i] = words[i];
+  }
+  u32 before = in.len;
+  ds_intern_bulk(&in, m, strs, NULL, out);
+  assert(in.len == before + m / 4);
+  for (size_t i = 0; i < m; i++) {
+    assert(!strcmp(ds_intern_str(&in, out[i]), strs[i]));
+    assert(ds_intern(&in, strs[i]) == out[i]);
+    if (i % 2)
+      assert(out[i] == ids[i / 4 * 4]);
+  }
+  size_t lens[3] = {3, 3, 2};
+  const char* three[3] = {"foo!", "new", "ba"};
+  ds_intern_bulk(&in, 3, three, lens, out);
+  assert(out[0] == foo && out[1] == in.len - 2 && out[2] == in.len - 1);
+
+  // downstream tables compare ids
+  struct count_table c;
+  count_init(&c);
+  for (size_t i = 0; i < m; i++) {
+    bool new;
+    int* v = count_entry(&c, ds_intern(&in, strs[i]), &new);
+    *v = new ? 1 : *v + 1;
+  }
+  assert(c.len == m / 2 && *count_lookup(&c, ds_intern(&in, "new_4")) == 2);
+  count_deinit(&c);
+  struct count_table* p = count_alloc();
+  assert(count_insert(p, foo, 1) && *count_lookup(p, foo) == 1);
+  count_free(p);
+
+  // find doesn't touch the arena, even when the block has no room left
+  for (int i = 0; (size_t)(in.end - in.pos) >= DS_INTERN_SIZE(30); i++) {
+    snprintf(s, sizeof(s), "fill_%d", i);
+    ds_intern(&in, s);
+  }
+  size_t arena = ds_intern_usage(&in).arena;
+  char* pos = in.pos;
+  assert(ds_intern_find(&in, "never interned, 30 bytes long", 29) ==
+         DS_INTERN_NONE);
+  assert(ds_intern_usage(&in).arena == arena && in.pos == pos);
+
+  struct ds_intern_usage u = ds_intern_usage(&in);
+  assert(u.strings == in.len && u.chars > n * 7);
+  assert(u.arena >= u.chars && u.table >= in.ids.cap * 17);
+  assert(u.ids >= in.len * sizeof(char*));
+  assert(u.total >= u.arena + u.table + u.ids);
+  ds_intern_deinit(&in);
+  free(ids);
+  free(ptrs);
+  free(words);
+  free(strs);
+  free(out);
+}
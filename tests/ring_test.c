@@ -0,0 +1,143 @@
+#include <pthread.h>
+#include <sched.h>
+
+#define RING_PREFIX spsc
+#define RING_TYPE u64
+
+#include "../ring.h"
+
+#define RING_PREFIX mpmc
+#define RING_TYPE u64
+#define RING_MPMC
+
+#include "../ring.h"
+
+#include "test.h"
+
+#define ITEMS 200000
+#define THREADS 4 // producers and as many consumers
+
+struct spsc_ring sq;
+struct mpmc_ring mq;
+u8 seen[THREADS * ITEMS];
+size_t popped; // by all consumers
+
+// pushes 0..ITEMS in batches of various sizes
+void* spsc_producer(void* arg) {
+  u64 xs[7];
+  for (u64 i = 0; i < ITEMS;) {
+    size_t n = ds_min(1 + i % 7, ITEMS - i);
+    for (size_t j = 0; j < n; j++)
+      xs[j] = i + j;
+    size_t k = spsc_push_n(&sq, xs, n);
+    if (k < n)
+      sched_yield();
+    i += k;
+  }
+  return NULL;
+}
+
+void* mpmc_producer(void* arg) {
+  u64 base = (u64)(intptr_t)arg * ITEMS;
+  u64 xs[5];
+  for (u64 i = 0; i < ITEMS;) {
+    if (i % 3) {
+      size_t n = ds_min(5, ITEMS - i);
+      for (size_t j = 0; j < n; j++)
+        xs[j] = base + i + j;
+      size_t k = mpmc_push_n(&mq, xs, n);
+      if (!k)
+        sched_yield();
+      i += k;
+    } else if (mpmc_push(&mq, base + i))
+      i++;
+    else
+      sched_yield();
+  }
+  return NULL;
+}
+
+// every item arrives exactly once, the ones of each producer in order
+void* mpmc_consumer(void* arg) {
+  u64 last[THREADS];
+  memset(last, 0xff, sizeof(last));
+  u64 xs[6];
+  while (__atomic_load_n(&popped, __ATOMIC_RELAXED) < THREADS * ITEMS) {
+    size_t k = mpmc_pop_n(&mq, xs, 1 + (size_t)(intptr_t)arg);
+    if (!k)
+      sched_yield();
+    for (size_t j = 0; j < k; j++) {
+      assert(!seen[xs[j]]);
+      seen[xs[j]] = 1;
+      size_t p = xs[j] / ITEMS;
+      assert(last[p] == ~0ull || last[p] < xs[j]);
+      last[p] = xs[j];
+    }
+    __atomic_fetch_add(&popped, k, __ATOMIC_RELAXED);
+  }
+  return NULL;
+}
+
+int main() {
+  // single thread: rounding, full, empty, wrap around
+  spsc_init(&sq, 5);
+  assert(sq.mask == 7);
+  u64 x, xs[16];
+  assert(!spsc_pop(&sq, &x) && spsc_len(&sq) == 0);
+  for (u64 round = 0; round < 3; round++) {
+    for (u64 i = 0; i < 16; i++)
+      xs[i] = round * 100 + i;
+    assert(spsc_push_n(&sq, xs, 3) == 3);
+    assert(spsc_push_n(&sq, xs + 3, 16) == 5);
+    assert(!spsc_push(&sq, 99) && spsc_len(&sq) == 8);
+    assert(spsc_pop(&sq, &x) && x == round * 100);
+    assert(spsc_push(&sq, 42));
+    assert(spsc_pop_n(&sq, xs, 16) == 8);
+    assert(xs[0] == round * 100 + 1 && xs[6] == round * 100 + 7 && xs[7] == 42);
+    assert(spsc_pop_n(&sq, xs, 16) == 0);
+  }
+  spsc_deinit(&sq);
+
+  struct mpmc_ring* m = mpmc_alloc(1);
+  assert(m->mask == 1 && (uintptr_t)m % 64 == 0);
+  assert(mpmc_push(m, 1) && mpmc_push(m, 2) && !mpmc_push(m, 3));
+  assert(mpmc_pop(m, &x) && x == 1 && mpmc_len(m) == 1);
+  for (u64 i = 0; i < 16; i++)
+    xs[i] = 10 + i;
+  assert(mpmc_push_n(m, xs, 16) == 1);
+  assert(mpmc_pop_n(m, xs, 16) == 2 && xs[0] == 2 && xs[1] == 10);
+  assert(!mpmc_pop(m, &x));
+  mpmc_free(m);
+
+  // head and tail don't share a line
+  assert(offsetof(struct spsc_ring, tail) - offsetof(struct spsc_ring, head) ==
+         64);
+
+  // threads
+  pthread_t th[2 * THREADS];
+  spsc_init(&sq, 64);
+  pthread_create(&th[0], NULL, spsc_producer, NULL);
+  for (u64 i = 0; i < ITEMS;) {
+    size_t k = spsc_pop_n(&sq, xs, 1 + i % 11);
+    if (!k)
+      sched_yield();
+    for (size_t j = 0; j < k; j++)
+      assert(xs[j] == i + j);
+    i += k;
+  }
+  pthread_join(th[0], NULL);
+  assert(spsc_len(&sq) == 0);
+  spsc_deinit(&sq);
+
+  mpmc_init(&mq, 64);
+  for (int i = 0; i < THREADS; i++) {
+    pthread_create(&th[i], NULL, mpmc_producer, (void*)(intptr_t)i);
+    pthread_create(&th[THREADS + i], NULL, mpmc_consumer, (void*)(intptr_t)i);
+  }
+  for (int i = 0; i < 2 * THREADS; i++)
+    pthread_join(th[i], NULL);
+  for (size_t i = 0; i < THREADS * ITEMS; i++)
+    assert(seen[i]);
+  assert(mpmc_len(&mq) == 0);
+  mpmc_deinit(&mq);
+}
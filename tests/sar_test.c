@@ -0,0 +1,104 @@
+#include "../sar.h"
+#include "test.h"
+
+// sar.h first must not turn bigalloc.h off for ar.h
+#include "../ar.h"
+#ifndef DS_BIGALLOC_H
+#  error "ar.h after sar.h doesn't use bigalloc.h"
+#endif
+
+void test_init_free() {
+  int** a;
+  sarinit(a);
+  escape(a);
+  sarfree(a);
+}
+
+void test_sarpush(size_t iter) {
+  int** a;
+  sarinit(a);
+
+  sarpush(a, 0);
+  int* first = &sarat(a, 0);
+  for (size_t i = 1; i < iter; i++) {
+    sarpush(a, i * 2);
+    assert(sarcap(a) >= sarlen(a));
+  }
+
+  // growing never moves elements
+  assert(first == &sarat(a, 0));
+  for (size_t i = 0; i < iter; i++)
+    assert(sarat(a, i) == i * 2);
+
+  escape(a);
+  sarfree(a);
+}
+
+void test_sarpop(size_t iter) {
+  int** a;
+  sarinit(a);
+
+  for (size_t i = 0; i < iter; i++)
+    sarpush(a, i * 5);
+
+  for (size_t i = 0; i < iter; i++) {
+    int e = (iter - i - 1) * 5;
+    assert(sarpeek(a) == e);
+    assert(sarpop(a) == e);
+  }
+
+  assert(sarlen(a) == 0);
+
+  escape(a);
+  sarfree(a);
+}
+
+void test_sarpushm(size_t iter) {
+  int** a;
+  sarinit(a);
+
+  sarpush(a, -1);
+  size_t s = sarpushm(a, iter);
+
+  assert(s == 1);
+  assert(sarcap(a) >= sarlen(a));
+  assert(sarlen(a) == iter + 1);
+
+  for (size_t i = 0; i < iter; i++)
+    sarat(a, s + i) = i * 3;
+
+  for (size_t i = 0; i < iter; i++)
+    assert(sarat(a, s + i) == i * 3);
+
+  escape(a);
+  sarfree(a);
+}
+
+void test_foreach(size_t iter) {
+  int** a;
+  sarinit(a);
+  sarpushm(a, iter);
+
+  sarforei(a, i) { // foreach by index. i is index
+    sarat(a, i) = 3;
+  }
+
+  size_t n = 0;
+  sarforev(a, v) { // foreach by value. v is value
+    assert(v == 3);
+    n++;
+  }
+  assert(n == iter);
+
+  escape(a);
+  sarfree(a);
+}
+
+int main() {
+  size_t iter = 5000;
+  test_init_free();
+  test_sarpush(iter);
+  test_sarpushm(iter);
+  test_sarpop(iter);
+  test_foreach(iter);
+}
@@ -1,3 +1,6 @@
+#ifndef DS_X_H
+#define DS_X_H
+
 #include <stdlib.h>
 #include <string.h>
 
@@ -23,3 +26,5 @@ static void* xstrdup(char* s) {
 		__builtin_trap();
 	return d;
 }
+
+#endif